@@ -7,3 +7,18 @@ endif()
 
 find_package(OpenGL REQUIRED)
 
+# When GL errors are checked: "call" after individual calls, "frame" at
+# frame boundaries, "debug" through KHR_debug callbacks, or "off".
+set(TRILLEK_GL_ERRORS "" CACHE STRING
+    "GL error checking (off, call, frame or debug; default call for Debug builds, else frame)")
+if(TRILLEK_GL_ERRORS STREQUAL "")
+    if(CMAKE_BUILD_TYPE STREQUAL "Debug")
+        set(TRILLEK_GL_ERRORS_POLICY "call")
+    else()
+        set(TRILLEK_GL_ERRORS_POLICY "frame")
+    endif()
+else()
+    set(TRILLEK_GL_ERRORS_POLICY ${TRILLEK_GL_ERRORS})
+endif()
+string(TOUPPER ${TRILLEK_GL_ERRORS_POLICY} TRILLEK_GL_ERRORS_POLICY)
+add_definitions(-DTRILLEK_GL_ERRORS_${TRILLEK_GL_ERRORS_POLICY})
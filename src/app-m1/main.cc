@@ -9,6 +9,9 @@
 #include "player.hh"
 #include <render_target.hh>
 #include <primitive.hh>
+#include <render_thread.hh>
+#include <render_queue.hh>
+#include <static_batch.hh>
 #include <boost/random.hpp>
 #include <iostream>
 #include <vector3.hh>
@@ -16,6 +19,7 @@
 
 #include <window_manager.hh>
 #include <window.hh>
+#include <event_log.hh>
 
 namespace trillek {
     extern platform_subsystem& get_platform_subsystem();
@@ -34,11 +38,89 @@ void dump_matrix4(const trillek::matrix4_t& pX) {
 
 
 void
-load_subsystems(trillek::subsystem_manager& pMgr)
+dump_startup_timings(const trillek::subsystem_manager& pMgr)
 {
     using namespace trillek;
-    pMgr.load(platform_subsystem::s_interface, get_platform_subsystem());
-    pMgr.load(system_event_queue::s_interface, get_system_event_queue());
+    std::cerr << "Startup (us): pre_init init post_init\n";
+    for (auto& t : pMgr.startup_timings()) {
+        std::cerr << "  " << t.mKey;
+        for (auto& p : t.mPhase) {
+            std::cerr << ' ' << p.count();
+        }
+        std::cerr << '\n';
+    }
+}
+
+
+// Command line options: input capture and replay, and render threading.
+struct client_options {
+    std::string mRecordPath;
+    std::string mReplayPath;
+    bool mReplayFast;
+    bool mRenderThread;
+
+    std::unique_ptr<trillek::system_event_recorder> mRecorder;
+    std::unique_ptr<trillek::platform_subsystem_replay> mReplay;
+
+    client_options()
+        : mReplayFast(false), mRenderThread(false)
+    {
+    }
+
+    void parse(int argc, char* argv[]) {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg(argv[i]);
+            if (arg == "--render-thread") {
+                mRenderThread = true;
+            }
+            else if (i + 1 == argc) {
+                break;
+            }
+            else if (arg == "--record") {
+                mRecordPath = argv[++i];
+            }
+            else if (arg == "--replay" || arg == "--replay-fast") {
+                mReplayPath = argv[++i];
+                mReplayFast = arg == "--replay-fast";
+            }
+        }
+    }
+
+    bool replay_finished() const {
+        return mReplay && mReplay->finished();
+    }
+
+    void end_frame() {
+        if (mRecorder) {
+            mRecorder->mark_frame();
+        }
+    }
+};
+
+
+void
+load_subsystems(trillek::subsystem_manager& pMgr, client_options& pOpts)
+{
+    using namespace trillek;
+
+    platform_subsystem* platform = &get_platform_subsystem();
+    if (!pOpts.mReplayPath.empty()) {
+        pOpts.mReplay.reset(new platform_subsystem_replay(*platform,
+            pOpts.mReplayPath, pOpts.mReplayFast
+                ? platform_subsystem_replay::REPLAY_MAX_SPEED
+                : platform_subsystem_replay::REPLAY_RECORDED_SPEED));
+        platform = pOpts.mReplay.get();
+    }
+
+    system_event_queue* queue = &get_system_event_queue();
+    if (!pOpts.mRecordPath.empty()) {
+        pOpts.mRecorder.reset(new system_event_recorder(*queue,
+            pOpts.mRecordPath));
+        queue = pOpts.mRecorder.get();
+    }
+
+    pMgr.load(platform_subsystem::s_interface, *platform);
+    pMgr.load(system_event_queue::s_interface, *queue);
     pMgr.load(graphics_subsystem::s_interface, graphics_subsystem::get_graphics_subsystem());
 }
 
@@ -58,9 +140,22 @@ struct milestone1 {
     std::shared_ptr<trillek::graphics_state> mHudState;
 
     bool mQuitEventPosted;
+    uint64_t mEventsDropped;
 
     std::shared_ptr<trillek::vertex_format> mVFormat;
-    std::vector<std::unique_ptr<trillek::mesh>> mMeshes;
+    std::vector<trillek::static_batch> mBatches;
+
+    // The mesh loop is split into this many ranges, recorded in parallel.
+    // Each range sorts its own draws and records them into its own list,
+    // and the lists go into the frame's command list in slot order.
+    static constexpr uint32_t s_sceneSlots = 8;
+    trillek::command_list_set mSceneCommands;
+    std::array<trillek::render_queue, s_sceneSlots> mSlotQueues;
+
+    // Frames are drawn from mPacket on this thread, or handed to
+    // mRenderThread if there is one.
+    trillek::frame_packet mPacket;
+    std::unique_ptr<trillek::render_thread> mRenderThread;
 
     trillek::float_t mRotation;
 
@@ -71,15 +166,18 @@ struct milestone1 {
           mGraphics(mMgr.lookup<trillek::graphics_subsystem>())
     {
         mQuitEventPosted = false;
+        mEventsDropped = 0;
         mRotation = 0;
     }
 
     void load_meshes();
 
-    std::unique_ptr<trillek::mesh> build_mesh(float pGreyscale, uint32_t pBegin, uint32_t pEnd);
+    void add_polygon(trillek::static_batcher& pBatcher, float pGreyscale,
+            uint32_t pBegin, uint32_t pEnd);
 
-    void init() {
+    void init(bool pRenderThread) {
         mMainWindow = mPlatform.get_window_manager().get_main_window();
+        mMainWindow->set_motion_coalescing(true);
         mDevice = mGraphics.create_device();
         mTarget = mDevice->make_window_target(mMainWindow);
       
@@ -93,6 +191,11 @@ struct milestone1 {
         mDevice->set_graphics_state(mBeautyPassState);
 
         load_meshes();
+
+        if (pRenderThread) {
+            mRenderThread.reset(new trillek::render_thread(mDevice, mTarget));
+            mRenderThread->start();
+        }
     }
 
     bool quit_event_posted() const {
@@ -103,38 +206,37 @@ struct milestone1 {
 
     void process_events();
 
-    void update() {
+    void update(trillek::frame_packet& pPacket) {
         using namespace trillek;
 
         uint32_t width, height;
         mMainWindow->get_dimensions(width, height);
-        mDevice->set_viewport(recti_t{0, 0, width, height});
+        pPacket.mViewport = recti_t{0, 0, width, height};
+        pPacket.mState = mBeautyPassState;
 
         camera c;
         c.update_projection_transform(recti_t(0,0,width,height),
                0.1f,1000.0f, 65.0f);
         c.update_camera_transform();
         // dump_matrix4(c.mProjectionXform);
-        mDevice->projection_transform() = c.mProjectionXform;
+        pPacket.mProjectionXform = c.mProjectionXform;
 
         matrix4_t cam(c.mCameraXform);
         cam.translate(vector3_t(50,0,0));
         cam.rotate(mRotation, vector3_t(0,1,0));
         // dump_matrix4(cam);
-        mDevice->camera_transform() = cam;
+        pPacket.mCameraXform = cam;
 
         matrix4_t model;
         // dump_matrix4(model);
-        mDevice->model_transform() = model;
+        pPacket.mModelXform = model;
 
-        matrix4_t mvp = mDevice->projection_transform();
-        mvp *= mDevice->camera_transform();
-        mvp *= mDevice->model_transform();
+        matrix4_t mvp = pPacket.mProjectionXform;
+        mvp *= pPacket.mCameraXform;
+        mvp *= pPacket.mModelXform;
         // dump_matrix4(mvp);
 
         mRotation += 0.5;
-
-        mDevice->update_state();
     }
 
     void hud_camera_begin() {
@@ -156,6 +258,9 @@ struct milestone1 {
     }
 
     void pre_shutdown() {
+        if (mRenderThread) {
+            mRenderThread->stop();
+        }
     }
 
     void frame();
@@ -176,6 +281,15 @@ milestone1::process_events() {
             mQuitEventPosted = true;
         }
     }
+
+    system_event_queue_stats stats;
+    mEvQueue.get_stats(stats);
+    if (stats.mDropped != mEventsDropped) {
+        std::cerr << "System event queue dropped "
+             << stats.mDropped - mEventsDropped << " events (high water "
+             << stats.mHighWater << ", capacity " << stats.mCapacity << ")\n";
+        mEventsDropped = stats.mDropped;
+    }
 }
 
 void
@@ -204,7 +318,12 @@ milestone1::process_event(const trillek::system_event_t& pEvent) {
                     break;
                 }
             }
-            cerr << ' ' << pEvent.mData << '\n';
+            cerr << ' ' << pEvent.mData;
+            if (pEvent.has_extra_data()) {
+                cerr << " (" << pEvent.extra_data<mouse_motion_data>().mSamples
+                     << " samples)";
+            }
+            cerr << '\n';
             break;
         }
 
@@ -247,15 +366,33 @@ milestone1::frame() {
 void
 milestone1::draw_frame() {
     using namespace trillek;
-    mDevice->begin_frame();
-    mDevice->set_render_target(mTarget);
-    update();
-    mDevice->clear(CLEAR_COLOR | CLEAR_DEPTH | CLEAR_STENCIL,
-        rgba_t(0.5f,0.2f,0.2f,1.0f), 1.0f, 0xffu);
-
-    for (auto& m: mMeshes) {
-        m->draw();
+
+    frame_packet* packet = &mPacket;
+    if (mRenderThread) {
+        packet = &mRenderThread->begin_packet();
+    }
+    else {
+        mPacket.reset();
     }
+    update(*packet);
+
+    mSceneCommands.record(s_sceneSlots,
+        [this](uint32_t pSlot, command_list& pList) {
+            if (pSlot == 0) {
+                pList.clear(CLEAR_COLOR | CLEAR_DEPTH | CLEAR_STENCIL,
+                    rgba_t(0.5f,0.2f,0.2f,1.0f), 1.0f, 0xffu);
+            }
+            render_queue& queue = mSlotQueues[pSlot];
+            queue.reset();
+            std::size_t begin = mBatches.size() * pSlot / s_sceneSlots;
+            std::size_t end = mBatches.size() * (pSlot + 1) / s_sceneSlots;
+            for (std::size_t i = begin; i < end; ++i) {
+                queue.submit(0, mBatches[i].mState, *mBatches[i].mMesh);
+            }
+            queue.sort();
+            queue.record(pList);
+        });
+    mSceneCommands.merge(packet->mCommands);
 
 #if 0
     hud_camera_begin();
@@ -264,8 +401,12 @@ milestone1::draw_frame() {
     hud_camera_end();
 #endif
 
-    mDevice->end_frame();
-    mTarget->swap_buffers();
+    if (mRenderThread) {
+        mRenderThread->submit_packet();
+    }
+    else {
+        render_frame_packet(*mDevice, mTarget, mPacket);
+    }
 }
 
 
@@ -910,13 +1051,10 @@ static unsigned sFaces[] = {
 #endif
 
 
-std::unique_ptr<trillek::mesh>
-milestone1::build_mesh(float pGreyscale, uint32_t pBegin, uint32_t pEnd) {
+void
+milestone1::add_polygon(trillek::static_batcher& pBatcher, float pGreyscale,
+        uint32_t pBegin, uint32_t pEnd) {
     using namespace trillek;
-    using namespace std;
-
-    unique_ptr<trillek::mesh> m
-        = mDevice->make_mesh(PRIM_POLYGON, mVFormat, pEnd - pBegin, BUFFER_STATIC);
 
     // Normals not attached to this mesh, unfortunately.
     point3_t& p0 = sVertices[sFaces[pBegin + 0] - 1];
@@ -925,22 +1063,24 @@ milestone1::build_mesh(float pGreyscale, uint32_t pBegin, uint32_t pEnd) {
     vector3_t n = (p0 - p1) ^ (p2 - p1);
     n.normalize();
 
-    {
-        mesh_builder b(*m);
-        for (uint32_t i = pBegin; i < pEnd; ++i) {
-            uint32_t v = sFaces[i] - 1;
-
-            b.position(sVertices[v]);
-            b.normal(n);
-            b.color(pGreyscale, pGreyscale, pGreyscale);
-            b.advance();
-        }
-    }
+    pBatcher.add_triangles(mBeautyPassState, mVFormat,
+        [=](indexed_mesh_builder& b) {
+            b.begin(PRIM_POLYGON);
+            for (uint32_t i = pBegin; i < pEnd; ++i) {
+                uint32_t v = sFaces[i] - 1;
 
-    return m;
+                b.position(sVertices[v]);
+                b.normal(n);
+                b.color(pGreyscale, pGreyscale, pGreyscale);
+                b.advance();
+            }
+            b.end();
+        });
 }
 
 
+// Every polygon shares a state and vertex format, so the whole model ends
+// up as one indexed triangle list drawn with one call.
 void
 milestone1::load_meshes() {
     using namespace trillek;
@@ -953,13 +1093,15 @@ milestone1::load_meshes() {
     boost::mt19937 rng;
     boost::uniform_01<boost::mt19937> unif(rng);
 
+    static_batcher batcher(*mDevice);
     uint32_t b = 0;
     for (unsigned i = 0; i < sizeof(sFaces) / sizeof(sFaces[0]); ++i) {
         if (!sFaces[i]) {
-            mMeshes.push_back(build_mesh(unif() * 0.5 + 0.5, b, i));
+            add_polygon(batcher, unif() * 0.5 + 0.5, b, i);
             b = i + 1;
         }
     }
+    mBatches = batcher.build();
 }
 
 
@@ -968,17 +1110,24 @@ int
 main(int argc, char* argv[]) {
     using namespace trillek;
 
+    client_options opts;
+    opts.parse(argc, argv);
+
     subsystem_manager& mgr = standard_subsystem_manager();
-    load_subsystems(mgr);
+    load_subsystems(mgr, opts);
     mgr.initialise();
+    dump_startup_timings(mgr);
 
     milestone1 m1(mgr);
 
-    m1.init();
+    m1.init(opts.mRenderThread);
 
-    while (!m1.quit_event_posted()) {
+    while (!m1.quit_event_posted() && !opts.replay_finished()) {
         m1.frame();
+        opts.end_frame();
     }
+
+    m1.pre_shutdown();
 }
 
 
@@ -0,0 +1,618 @@
+#include <command_list.hh>
+#include <primitive.hh>
+#include <graphics_state.hh>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+namespace trillek {
+
+namespace {
+
+    struct clear_args {
+        clear_flags_t mFlags;
+        float_t mColor[4];
+        float_t mDepth;
+        uint32_t mStencil;
+    };
+
+    struct draw_args {
+        uint32_t mType;
+        uint32_t mVertexStart;
+        uint32_t mPrimitiveCount;
+    };
+
+    struct draw_indexed_args {
+        uint32_t mType;
+        uint32_t mIndexType;
+        uint32_t mIndexStart;
+        uint32_t mPrimitiveCount;
+    };
+
+    // Followed by mRanges vertex starts, then mRanges primitive counts.
+    struct draw_ranges_args {
+        uint32_t mType;
+        uint32_t mRanges;
+    };
+
+    // Keeps a ranged draw inside the 16-bit command size.
+    static constexpr uint32_t MAX_RANGES_PER_COMMAND = 4096;
+
+    // Followed by mCount instance_t.
+    struct draw_instanced_args {
+        mesh* mMesh;
+        uint32_t mCount;
+    };
+
+    // Likewise for instanced draws.
+    static constexpr uint32_t MAX_INSTANCES_PER_COMMAND = 512;
+
+    template<typename T>
+    inline T
+    read_arg(const uint8_t* pArgs) {
+        T arg;
+        std::memcpy(&arg, pArgs, sizeof(T));
+        return arg;
+    }
+
+}
+
+
+command_list::command_list()
+{
+    mCommandCount = 0;
+}
+
+
+command_list::~command_list()
+{
+}
+
+
+void
+command_list::reset()
+{
+    mBuffer.clear();
+    mResources.clear();
+    mCommandCount = 0;
+}
+
+
+uint8_t*
+command_list::begin_command(command_op_t pOp, std::size_t pSize)
+{
+    // Commands are padded to keep every header and argument block 4-byte
+    // aligned.
+    pSize = (pSize + 3) & ~std::size_t(3);
+
+    header h;
+    h.mOp = pOp;
+    h.mSize = pSize;
+
+    std::size_t offset = mBuffer.size();
+    ensure_capacity(mBuffer, sizeof(header) + pSize);
+    mBuffer.resize(offset + sizeof(header) + pSize);
+    std::memcpy(&mBuffer[offset], &h, sizeof(header));
+    ++mCommandCount;
+    return &mBuffer[offset + sizeof(header)];
+}
+
+
+uint32_t
+command_list::add_resource(std::shared_ptr<void> pResource)
+{
+    // Consecutive commands very often name the same object.
+    if (!mResources.empty() && mResources.back() == pResource) {
+        return mResources.size() - 1;
+    }
+    mResources.push_back(std::move(pResource));
+    return mResources.size() - 1;
+}
+
+
+void
+command_list::set_render_target(std::shared_ptr<render_target> pTarget)
+{
+    record(CMD_SET_RENDER_TARGET, add_resource(std::move(pTarget)));
+}
+
+
+void
+command_list::set_graphics_state(std::shared_ptr<graphics_state> pState)
+{
+    record(CMD_SET_GRAPHICS_STATE, add_resource(std::move(pState)));
+}
+
+
+void
+command_list::push_graphics_state()
+{
+    begin_command(CMD_PUSH_GRAPHICS_STATE, 0);
+}
+
+
+void
+command_list::pop_graphics_state()
+{
+    begin_command(CMD_POP_GRAPHICS_STATE, 0);
+}
+
+
+void
+command_list::set_vertex_buffer(std::shared_ptr<vertex_buffer> pBuf)
+{
+    record(CMD_SET_VERTEX_BUFFER, add_resource(std::move(pBuf)));
+}
+
+
+void
+command_list::set_index_buffer(std::shared_ptr<index_buffer> pBuf)
+{
+    record(CMD_SET_INDEX_BUFFER, add_resource(std::move(pBuf)));
+}
+
+
+void
+command_list::set_viewport(const recti_t& pRect)
+{
+    record(CMD_SET_VIEWPORT, pRect);
+}
+
+
+void
+command_list::set_model_transform(const matrix4_t& pXform)
+{
+    record(CMD_SET_MODEL_TRANSFORM, pXform);
+}
+
+
+void
+command_list::push_model_transform()
+{
+    begin_command(CMD_PUSH_MODEL_TRANSFORM, 0);
+}
+
+
+void
+command_list::pop_model_transform()
+{
+    begin_command(CMD_POP_MODEL_TRANSFORM, 0);
+}
+
+
+void
+command_list::set_camera_transform(const matrix4_t& pXform)
+{
+    record(CMD_SET_CAMERA_TRANSFORM, pXform);
+}
+
+
+void
+command_list::set_projection_transform(const matrix4_t& pXform)
+{
+    record(CMD_SET_PROJECTION_TRANSFORM, pXform);
+}
+
+
+void
+command_list::update_state(bool pForce)
+{
+    record(CMD_UPDATE_STATE, (uint8_t)pForce);
+}
+
+
+void
+command_list::clear(clear_flags_t pFlags, const rgba_t& pColor,
+        float_t pDepth, uint32_t pStencil)
+{
+    clear_args args;
+    args.mFlags = pFlags;
+    args.mColor[0] = pColor.r;
+    args.mColor[1] = pColor.g;
+    args.mColor[2] = pColor.b;
+    args.mColor[3] = pColor.a;
+    args.mDepth = pDepth;
+    args.mStencil = pStencil;
+    record(CMD_CLEAR, args);
+}
+
+
+void
+command_list::draw_primitive(primitive_type_t pType, uint32_t pVertexStart,
+        uint32_t pPrimitiveCount)
+{
+    draw_args args;
+    args.mType = pType;
+    args.mVertexStart = pVertexStart;
+    args.mPrimitiveCount = pPrimitiveCount;
+    record(CMD_DRAW_PRIMITIVE, args);
+}
+
+
+void
+command_list::draw_primitive_ranges(primitive_type_t pType,
+        const uint32_t* pVertexStarts, const uint32_t* pPrimitiveCounts,
+        uint32_t pRanges)
+{
+    while (pRanges > 0) {
+        draw_ranges_args args;
+        args.mType = pType;
+        args.mRanges = std::min(pRanges, MAX_RANGES_PER_COMMAND);
+
+        std::size_t arraySize = args.mRanges * sizeof(uint32_t);
+        uint8_t* p = begin_command(CMD_DRAW_PRIMITIVE_RANGES,
+            sizeof(args) + arraySize * 2);
+        std::memcpy(p, &args, sizeof(args));
+        std::memcpy(p + sizeof(args), pVertexStarts, arraySize);
+        std::memcpy(p + sizeof(args) + arraySize, pPrimitiveCounts, arraySize);
+
+        pVertexStarts += args.mRanges;
+        pPrimitiveCounts += args.mRanges;
+        pRanges -= args.mRanges;
+    }
+}
+
+
+void
+command_list::draw_indexed_primitive(primitive_type_t pType,
+        index_type_t pIndexType, uint32_t pIndexStart,
+        uint32_t pPrimitiveCount)
+{
+    draw_indexed_args args;
+    args.mType = pType;
+    args.mIndexType = pIndexType;
+    args.mIndexStart = pIndexStart;
+    args.mPrimitiveCount = pPrimitiveCount;
+    record(CMD_DRAW_INDEXED_PRIMITIVE, args);
+}
+
+
+void
+command_list::draw_mesh(mesh& pMesh)
+{
+    mesh* m = &pMesh;
+    record(CMD_DRAW_MESH, m);
+}
+
+
+void
+command_list::draw_instanced(mesh& pMesh, const instance_t* pInstances,
+        uint32_t pCount)
+{
+    while (pCount > 0) {
+        draw_instanced_args args;
+        args.mMesh = &pMesh;
+        args.mCount = std::min(pCount, MAX_INSTANCES_PER_COMMAND);
+
+        std::size_t arraySize = args.mCount * sizeof(instance_t);
+        uint8_t* p = begin_command(CMD_DRAW_INSTANCED,
+            sizeof(args) + arraySize);
+        std::memcpy(p, &args, sizeof(args));
+        std::memcpy(p + sizeof(args), pInstances, arraySize);
+
+        pInstances += args.mCount;
+        pCount -= args.mCount;
+    }
+}
+
+
+void
+command_list::append(const command_list& pList)
+{
+    // Resource indices in the appended commands have to be rebased.
+    uint32_t base = mResources.size();
+    mResources.insert(mResources.end(), pList.mResources.begin(),
+            pList.mResources.end());
+
+    std::size_t offset = mBuffer.size();
+    mBuffer.insert(mBuffer.end(), pList.mBuffer.begin(), pList.mBuffer.end());
+    mCommandCount += pList.mCommandCount;
+
+    if (base == 0) {
+        return;
+    }
+
+    while (offset < mBuffer.size()) {
+        header h;
+        std::memcpy(&h, &mBuffer[offset], sizeof(header));
+        uint8_t* args = &mBuffer[offset + sizeof(header)];
+        switch (h.mOp) {
+        case CMD_SET_RENDER_TARGET:
+        case CMD_SET_GRAPHICS_STATE:
+        case CMD_SET_VERTEX_BUFFER:
+        case CMD_SET_INDEX_BUFFER: {
+            uint32_t index = read_arg<uint32_t>(args) + base;
+            std::memcpy(args, &index, sizeof(index));
+            break;
+        }
+
+        default:
+            break;
+        }
+        offset += sizeof(header) + h.mSize;
+    }
+}
+
+
+void
+command_list::execute(graphics_device& pDevice) const
+{
+    const uint8_t* p = mBuffer.data();
+    const uint8_t* end = p + mBuffer.size();
+
+    while (p < end) {
+        header h;
+        std::memcpy(&h, p, sizeof(header));
+        const uint8_t* args = p + sizeof(header);
+        p = args + h.mSize;
+
+        switch (h.mOp) {
+        case CMD_SET_RENDER_TARGET:
+            pDevice.set_render_target(std::static_pointer_cast<render_target>(
+                mResources[read_arg<uint32_t>(args)]
+            ));
+            break;
+
+        case CMD_SET_GRAPHICS_STATE:
+            pDevice.set_graphics_state(std::static_pointer_cast<graphics_state>(
+                mResources[read_arg<uint32_t>(args)]
+            ));
+            break;
+
+        case CMD_PUSH_GRAPHICS_STATE:
+            pDevice.push_graphics_state();
+            break;
+
+        case CMD_POP_GRAPHICS_STATE:
+            pDevice.pop_graphics_state();
+            break;
+
+        case CMD_SET_VERTEX_BUFFER:
+            pDevice.set_vertex_buffer(std::static_pointer_cast<vertex_buffer>(
+                mResources[read_arg<uint32_t>(args)]
+            ));
+            break;
+
+        case CMD_SET_INDEX_BUFFER:
+            pDevice.set_index_buffer(std::static_pointer_cast<index_buffer>(
+                mResources[read_arg<uint32_t>(args)]
+            ));
+            break;
+
+        case CMD_SET_VIEWPORT:
+            pDevice.set_viewport(read_arg<recti_t>(args));
+            break;
+
+        case CMD_SET_MODEL_TRANSFORM:
+            pDevice.model_transform() = read_arg<matrix4_t>(args);
+            break;
+
+        case CMD_PUSH_MODEL_TRANSFORM:
+            pDevice.push_model_transform();
+            break;
+
+        case CMD_POP_MODEL_TRANSFORM:
+            pDevice.pop_model_transform();
+            break;
+
+        case CMD_SET_CAMERA_TRANSFORM:
+            pDevice.camera_transform() = read_arg<matrix4_t>(args);
+            break;
+
+        case CMD_SET_PROJECTION_TRANSFORM:
+            pDevice.projection_transform() = read_arg<matrix4_t>(args);
+            break;
+
+        case CMD_UPDATE_STATE:
+            pDevice.update_state(read_arg<uint8_t>(args) != 0);
+            break;
+
+        case CMD_CLEAR: {
+            clear_args c = read_arg<clear_args>(args);
+            pDevice.clear(c.mFlags,
+                    rgba_t(c.mColor[0], c.mColor[1], c.mColor[2], c.mColor[3]),
+                    c.mDepth, c.mStencil);
+            break;
+        }
+
+        case CMD_DRAW_PRIMITIVE: {
+            draw_args d = read_arg<draw_args>(args);
+            pDevice.draw_primitive((primitive_type_t)d.mType,
+                    d.mVertexStart, d.mPrimitiveCount);
+            break;
+        }
+
+        case CMD_DRAW_PRIMITIVE_RANGES: {
+            draw_ranges_args d = read_arg<draw_ranges_args>(args);
+            const uint32_t* starts
+                = reinterpret_cast<const uint32_t*>(args + sizeof(d));
+            pDevice.draw_primitive_ranges((primitive_type_t)d.mType,
+                starts, starts + d.mRanges, d.mRanges);
+            break;
+        }
+
+        case CMD_DRAW_INDEXED_PRIMITIVE: {
+            draw_indexed_args d = read_arg<draw_indexed_args>(args);
+            pDevice.draw_indexed_primitive((primitive_type_t)d.mType,
+                    (index_type_t)d.mIndexType, d.mIndexStart,
+                    d.mPrimitiveCount);
+            break;
+        }
+
+        case CMD_DRAW_MESH:
+            read_arg<mesh*>(args)->draw();
+            break;
+
+        case CMD_DRAW_INSTANCED: {
+            draw_instanced_args d = read_arg<draw_instanced_args>(args);
+            pDevice.draw_instanced(*d.mMesh,
+                reinterpret_cast<const instance_t*>(args + sizeof(d)),
+                d.mCount);
+            break;
+        }
+
+        default:
+            throw std::logic_error("command_list::execute");
+        }
+    }
+}
+
+
+
+// Workers sleep between calls to record() rather than being created per
+// frame. Slots are handed out one at a time from mNextSlot, so a slow slot
+// doesn't hold up a whole block of others.
+struct command_list_set::impl {
+    std::vector<std::thread> mWorkers;
+
+    std::mutex mLock;
+    std::condition_variable mWake;
+    std::condition_variable mDone;
+    uint64_t mGeneration;
+    bool mQuit;
+    unsigned mBusy;
+
+    const record_function* mRecord;
+    command_list_set* mSet;
+    std::atomic<uint32_t> mNextSlot;
+    std::vector<std::exception_ptr> mErrors;
+
+    impl(unsigned pWorkers)
+        : mGeneration(0), mQuit(false), mBusy(0), mRecord(nullptr),
+          mSet(nullptr), mNextSlot(0)
+    {
+        for (unsigned i = 0; i < pWorkers; ++i) {
+            mWorkers.push_back(std::thread([this]() { worker(); }));
+        }
+    }
+
+    ~impl() {
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            mQuit = true;
+        }
+        mWake.notify_all();
+        for (auto& t : mWorkers) {
+            t.join();
+        }
+    }
+
+    void run_slots() {
+        for (;;) {
+            uint32_t slot = mNextSlot.fetch_add(1, std::memory_order_relaxed);
+            if (slot >= mSet->mSlots) {
+                break;
+            }
+            try {
+                (*mRecord)(slot, *mSet->mLists[slot]);
+            }
+            catch (...) {
+                mErrors[slot] = std::current_exception();
+            }
+        }
+    }
+
+    void worker() {
+        uint64_t seen = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mLock);
+                mWake.wait(lock, [&]() {
+                    return mQuit || mGeneration != seen;
+                });
+                if (mQuit) {
+                    return;
+                }
+                seen = mGeneration;
+            }
+
+            run_slots();
+
+            std::lock_guard<std::mutex> lock(mLock);
+            if (--mBusy == 0) {
+                mDone.notify_one();
+            }
+        }
+    }
+
+    void record(command_list_set& pSet, const record_function& pRecord) {
+        mSet = &pSet;
+        mRecord = &pRecord;
+        mErrors.assign(pSet.mSlots, std::exception_ptr());
+        mNextSlot = 0;
+
+        if (mWorkers.empty() || pSet.mSlots <= 1) {
+            run_slots();
+        }
+        else {
+            {
+                std::lock_guard<std::mutex> lock(mLock);
+                mBusy = mWorkers.size();
+                ++mGeneration;
+            }
+            mWake.notify_all();
+            run_slots();
+
+            std::unique_lock<std::mutex> lock(mLock);
+            mDone.wait(lock, [&]() { return mBusy == 0; });
+        }
+
+        mRecord = nullptr;
+        for (auto& e : mErrors) {
+            if (e) {
+                std::rethrow_exception(e);
+            }
+        }
+    }
+};
+
+
+command_list_set::command_list_set(unsigned pThreads)
+    : mSlots(0)
+{
+    if (pThreads == 0) {
+        pThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    mPImpl.reset(new impl(pThreads - 1));
+}
+
+
+command_list_set::~command_list_set()
+{
+}
+
+
+void
+command_list_set::record(uint32_t pSlots, const record_function& pRecord)
+{
+    while (mLists.size() < pSlots) {
+        mLists.emplace_back(new command_list());
+    }
+    for (uint32_t i = 0; i < pSlots; ++i) {
+        mLists[i]->reset();
+    }
+    mSlots = pSlots;
+    mPImpl->record(*this, pRecord);
+}
+
+
+void
+command_list_set::execute(graphics_device& pDevice) const
+{
+    for (uint32_t i = 0; i < mSlots; ++i) {
+        mLists[i]->execute(pDevice);
+    }
+}
+
+
+void
+command_list_set::merge(command_list& pList) const
+{
+    for (uint32_t i = 0; i < mSlots; ++i) {
+        pList.append(*mLists[i]);
+    }
+}
+
+}
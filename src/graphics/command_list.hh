@@ -0,0 +1,177 @@
+#ifndef COMMAND_LIST_HH_INCLUDED
+#define COMMAND_LIST_HH_INCLUDED
+
+#include <graphics_device.hh>
+#include <functional>
+
+namespace trillek {
+
+    class mesh;
+
+    enum command_op_t {
+        CMD_SET_RENDER_TARGET = 0,
+        CMD_SET_GRAPHICS_STATE,
+        CMD_PUSH_GRAPHICS_STATE,
+        CMD_POP_GRAPHICS_STATE,
+        CMD_SET_VERTEX_BUFFER,
+        CMD_SET_INDEX_BUFFER,
+        CMD_SET_VIEWPORT,
+        CMD_SET_MODEL_TRANSFORM,
+        CMD_PUSH_MODEL_TRANSFORM,
+        CMD_POP_MODEL_TRANSFORM,
+        CMD_SET_CAMERA_TRANSFORM,
+        CMD_SET_PROJECTION_TRANSFORM,
+        CMD_UPDATE_STATE,
+        CMD_CLEAR,
+        CMD_DRAW_PRIMITIVE,
+        CMD_DRAW_PRIMITIVE_RANGES,
+        CMD_DRAW_INDEXED_PRIMITIVE,
+        CMD_DRAW_MESH,
+        CMD_DRAW_INSTANCED,
+        CMD_LAST
+    };
+
+    // Records graphics_device calls into a linear buffer so they can be
+    // replayed against a device later, possibly on another thread.
+    //
+    // Each command is a small header followed by its arguments, padded to
+    // four bytes and packed back to back. Objects held by shared_ptr are
+    // kept alive by the list until reset(); meshes are recorded by
+    // address, and the caller must keep them alive until the list has
+    // been executed.
+    class command_list : private boost::noncopyable {
+    public:
+        command_list();
+
+        ~command_list();
+
+        // Forget every recorded command, keeping the allocated storage.
+        void reset();
+
+        void set_render_target(std::shared_ptr<render_target> pTarget);
+
+        void set_graphics_state(std::shared_ptr<graphics_state> pState);
+        void push_graphics_state();
+        void pop_graphics_state();
+
+        void set_vertex_buffer(std::shared_ptr<vertex_buffer> pBuf);
+
+        void set_index_buffer(std::shared_ptr<index_buffer> pBuf);
+
+        void set_viewport(const recti_t& pRect);
+
+        void set_model_transform(const matrix4_t& pXform);
+        void push_model_transform();
+        void pop_model_transform();
+
+        void set_camera_transform(const matrix4_t& pXform);
+
+        void set_projection_transform(const matrix4_t& pXform);
+
+        void update_state(bool pForce = false);
+
+        void clear(clear_flags_t pFlags, const rgba_t& pColor,
+                float_t pDepth, uint32_t pStencil);
+
+        void draw_primitive(primitive_type_t pType, uint32_t pVertexStart,
+                uint32_t pPrimitiveCount);
+
+        void draw_primitive_ranges(primitive_type_t pType,
+                const uint32_t* pVertexStarts,
+                const uint32_t* pPrimitiveCounts, uint32_t pRanges);
+
+        void draw_indexed_primitive(primitive_type_t pType,
+                index_type_t pIndexType, uint32_t pIndexStart,
+                uint32_t pPrimitiveCount);
+
+        void draw_mesh(mesh& pMesh);
+
+        // The instances are copied into the list.
+        void draw_instanced(mesh& pMesh, const instance_t* pInstances,
+                uint32_t pCount);
+
+        // Replay every command, in order, on pDevice.
+        void execute(graphics_device& pDevice) const;
+
+        // Append another list's commands to this one.
+        void append(const command_list& pList);
+
+        uint32_t command_count() const {
+            return mCommandCount;
+        }
+
+        // The encoded command stream, for measurement and serialisation.
+        // Resource arguments are indices into the list's own table.
+        const uint8_t* data() const {
+            return mBuffer.data();
+        }
+
+        std::size_t size_bytes() const {
+            return mBuffer.size();
+        }
+
+    private:
+        struct header {
+            uint16_t mOp;
+            uint16_t mSize;
+        };
+
+        std::vector<uint8_t> mBuffer;
+        std::vector<std::shared_ptr<void>> mResources;
+        uint32_t mCommandCount;
+
+        uint8_t* begin_command(command_op_t pOp, std::size_t pSize);
+
+        uint32_t add_resource(std::shared_ptr<void> pResource);
+
+        template<typename T>
+        void record(command_op_t pOp, const T& pArg) {
+            std::memcpy(begin_command(pOp, sizeof(T)), &pArg, sizeof(T));
+        }
+    };
+
+
+    // A numbered set of command lists which worker threads fill in
+    // parallel. Each slot is recorded by exactly one thread, and the lists
+    // are always submitted in slot order, so the merged command stream
+    // doesn't depend on how the work happened to be scheduled.
+    class command_list_set : private boost::noncopyable {
+    public:
+        typedef std::function<void (uint32_t pSlot, command_list& pList)>
+            record_function;
+
+        // pThreads counts the calling thread, so 1 records serially.
+        command_list_set(unsigned pThreads = 0);
+
+        ~command_list_set();
+
+        // Reset the set to pSlots empty lists and call pRecord once for
+        // each. If any call throws, the exception from the lowest slot is
+        // rethrown once every slot has finished.
+        void record(uint32_t pSlots, const record_function& pRecord);
+
+        uint32_t slots() const {
+            return mSlots;
+        }
+
+        const command_list& operator[](uint32_t pSlot) const {
+            return *mLists[pSlot];
+        }
+
+        // Replay every list, in slot order, on pDevice.
+        void execute(graphics_device& pDevice) const;
+
+        // Concatenate every list, in slot order, onto pList.
+        void merge(command_list& pList) const;
+
+    private:
+        uint32_t mSlots;
+        std::vector<std::unique_ptr<command_list>> mLists;
+
+        struct impl;
+        std::unique_ptr<impl> mPImpl;
+    };
+
+}
+
+#endif // COMMAND_LIST_HH_INCLUDED
@@ -1,24 +1,24 @@
 #include <draw_immediate.hh>
 #include <primitive.hh>
+#include <algorithm>
 
 namespace trillek {
 
 namespace {
 
-    inline std::shared_ptr<vertex_buffer>
-    volatile_vertex_buffer(graphics_device& pDevice, unsigned pVertices) {
-        return pDevice.make_vertex_buffer(
-            pDevice.standard_vertex_format(STD_VTX_FMT_PC),
-            pVertices,
-            BUFFER_VOLATILE
-        );
+    // Enough for a few hundred HUD rectangles before the ring grows.
+    static constexpr uint32_t INITIAL_RING_VERTICES = 4096;
+
+    inline bool
+    same_matrix(const matrix4_t& pA, const matrix4_t& pB) {
+        return !std::memcmp(&pA.mM, &pB.mM, sizeof(pA.mM));
     }
 
 }
 
 
 draw_immediate::draw_immediate(graphics_device& pDevice)
-    : mDevice(pDevice)
+    : mDevice(pDevice), mRingCapacity(0), mRingWrite(0)
 {
 }
 
@@ -28,38 +28,73 @@ draw_immediate::~draw_immediate()
 }
 
 
+void
+draw_immediate::begin_batch(primitive_type_t pType)
+{
+    // Reading through the non-const device would mark it dirty.
+    const graphics_device& device = mDevice;
+    const std::shared_ptr<graphics_state>& state = device.get_graphics_state();
+    const matrix4_t& model = device.model_transform();
+    const matrix4_t& camera = device.camera_transform();
+    const matrix4_t& projection = device.projection_transform();
+
+    if (!mBatches.empty()) {
+        const batch& last = mBatches.back();
+        if (last.mType == pType && last.mState == state
+                && same_matrix(last.mModelXform, model)
+                && same_matrix(last.mCameraXform, camera)
+                && same_matrix(last.mProjectionXform, projection)) {
+            return;
+        }
+    }
+
+    mBatches.push_back(batch());
+    batch& b = mBatches.back();
+    b.mType = pType;
+    b.mState = state;
+    b.mModelXform = model;
+    b.mCameraXform = camera;
+    b.mProjectionXform = projection;
+    b.mFirst = mVertices.size();
+    b.mCount = 0;
+}
+
+
+void
+draw_immediate::add_strip(const point2_t* pPoints, uint32_t pCount,
+        const rgba_t& pColor)
+{
+    begin_batch(PRIM_TRIANGLES);
+    for (uint32_t i = 0; i + 2 < pCount; ++i) {
+        uint32_t a = i & 1 ? i + 1 : i;
+        uint32_t b = i & 1 ? i : i + 1;
+        add_vertex(pPoints[a].x, pPoints[a].y, pColor);
+        add_vertex(pPoints[b].x, pPoints[b].y, pColor);
+        add_vertex(pPoints[i + 2].x, pPoints[i + 2].y, pColor);
+    }
+    mBatches.back().mCount += (pCount - 2) * 3;
+}
+
+
 void
 draw_immediate::draw_rect(const point2_t& pUL, const point2_t& pLR,
                     const rgba_t& pColor)
 {
-    auto vb = volatile_vertex_buffer(mDevice, 10);
-    {
-        vertex_buffer_builder<std_vtx_fmt_pc_t> b(*vb);
-        float_t off = 0.5f;
-        float_t hw = 0.5f;
-        b[0].mPosition.set(pUL.x + hw + off, pUL.y + off + hw, 0.0f);
-        b[0].mColor = pColor;
-        b[1].mPosition.set(pUL.x + hw + off, pUL.y + off - hw, 0.0f);
-        b[1].mColor = pColor;
-        b[2].mPosition.set(pLR.x + hw, pUL.y + off + hw, 0.0f);
-        b[2].mColor = pColor;
-        b[3].mPosition.set(pLR.x - hw, pUL.y + off - hw, 0.0f);
-        b[3].mColor = pColor;
-        b[4].mPosition.set(pLR.x - hw, pLR.y - hw, 0.0f);
-        b[4].mColor = pColor;
-        b[5].mPosition.set(pLR.x + hw, pLR.y + hw, 0.0f);
-        b[5].mColor = pColor;
-        b[6].mPosition.set(pUL.x - hw + off, pLR.y - hw, 0.0f);
-        b[6].mColor = pColor;
-        b[7].mPosition.set(pUL.x + hw + off, pLR.y + hw, 0.0f);
-        b[7].mColor = pColor;
-        b[8].mPosition.set(pUL.x + hw + off, pUL.y + off + hw, 0.0f);
-        b[8].mColor = pColor;
-        b[9].mPosition.set(pUL.x - hw + off, pUL.y + off - hw, 0.0f);
-        b[9].mColor = pColor;
-    }
-    mDevice.set_vertex_buffer(vb);
-    mDevice.draw_primitive(PRIM_TRIANGLE_STRIP, 0, 8);
+    float_t off = 0.5f;
+    float_t hw = 0.5f;
+    point2_t strip[10] = {
+        point2_t(pUL.x + hw + off, pUL.y + off + hw),
+        point2_t(pUL.x + hw + off, pUL.y + off - hw),
+        point2_t(pLR.x + hw, pUL.y + off + hw),
+        point2_t(pLR.x - hw, pUL.y + off - hw),
+        point2_t(pLR.x - hw, pLR.y - hw),
+        point2_t(pLR.x + hw, pLR.y + hw),
+        point2_t(pUL.x - hw + off, pLR.y - hw),
+        point2_t(pUL.x + hw + off, pLR.y + hw),
+        point2_t(pUL.x + hw + off, pUL.y + off + hw),
+        point2_t(pUL.x - hw + off, pUL.y + off - hw)
+    };
+    add_strip(strip, 10, pColor);
 }
 
 
@@ -67,31 +102,15 @@ void
 draw_immediate::fill_rect(const point2_t& pUL, const point2_t& pLR,
                     const rgba_t& pColor)
 {
-    auto vb = volatile_vertex_buffer(mDevice, 4);
-    {
-        vertex_buffer_builder<std_vtx_fmt_pc_t> b(*vb);
-        float_t off = 0.5f;
-        float_t hw = 0.5f;
-        b[0].mPosition.set(pUL.x + hw + off, pUL.y + off + hw, 0.0f);
-        b[0].mColor = pColor;
-        b[1].mPosition.set(pLR.x + hw, pUL.y + off + hw, 0.0f);
-        b[1].mColor = pColor;
-        b[2].mPosition.set(pUL.x - hw + off, pLR.y + off - hw, 0.0f);
-        b[2].mColor = pColor;
-        b[3].mPosition.set(pLR.x - hw, pLR.y - hw, 0.0f);
-        b[3].mColor = pColor;
-        std::cerr << "fill_rect:\n";
-        std::cerr << "  (" << b[0].mPosition.x << ',' << b[0].mPosition.y
-                << ',' << b[0].mPosition.z << ")\n";
-        std::cerr << "  (" << b[1].mPosition.x << ',' << b[1].mPosition.y
-                << ',' << b[1].mPosition.z << ")\n";
-        std::cerr << "  (" << b[2].mPosition.x << ',' << b[2].mPosition.y
-                << ',' << b[2].mPosition.z << ")\n";
-        std::cerr << "  (" << b[3].mPosition.x << ',' << b[3].mPosition.y
-                << ',' << b[3].mPosition.z << ")\n";
-    }
-    mDevice.set_vertex_buffer(vb);
-    mDevice.draw_primitive(PRIM_TRIANGLE_STRIP, 0, 2);
+    float_t off = 0.5f;
+    float_t hw = 0.5f;
+    point2_t strip[4] = {
+        point2_t(pUL.x + hw + off, pUL.y + off + hw),
+        point2_t(pLR.x + hw, pUL.y + off + hw),
+        point2_t(pUL.x - hw + off, pLR.y + off - hw),
+        point2_t(pLR.x - hw, pLR.y - hw)
+    };
+    add_strip(strip, 4, pColor);
 }
 
 
@@ -99,17 +118,85 @@ void
 draw_immediate::draw_line(const point2_t& pStart, const point2_t& pEnd,
                     const rgba_t& pColor)
 {
-    auto vb = volatile_vertex_buffer(mDevice, 2);
+    begin_batch(PRIM_LINES);
+    add_vertex(pStart.x, pStart.y, pColor);
+    add_vertex(pEnd.x, pEnd.y, pColor);
+    mBatches.back().mCount += 2;
+}
+
+
+// Copy the queued vertices into the ring, and return where they start.
+uint32_t
+draw_immediate::upload()
+{
+    uint32_t count = mVertices.size();
+    if (count > mRingCapacity) {
+        uint32_t capacity = std::max(mRingCapacity, INITIAL_RING_VERTICES);
+        while (capacity < count) {
+            capacity *= 2;
+        }
+        mRing = mDevice.make_vertex_buffer(
+            mDevice.standard_vertex_format(STD_VTX_FMT_PC),
+            capacity,
+            BUFFER_VOLATILE
+        );
+        mRingCapacity = capacity;
+        mRingWrite = 0;
+    }
+    if (mRingWrite + count > mRingCapacity) {
+        mRingWrite = 0;
+    }
+
+    uint32_t first = mRingWrite;
     {
-        vertex_buffer_builder<std_vtx_fmt_pc_t> b(*vb);
-        b[0].mPosition.set(pStart.x, pStart.y, 0.0f);
-        b[0].mColor = pColor;
-        b[1].mPosition.set(pEnd.x, pEnd.y, 0.0f);
-        b[1].mColor = pColor;
+        vertex_buffer_builder<std_vtx_fmt_pc_t> b(*mRing, first, count);
+        std::memcpy(&b[0], mVertices.data(),
+                count * sizeof(std_vtx_fmt_pc_t));
     }
-    mDevice.set_vertex_buffer(vb);
-    mDevice.draw_primitive(PRIM_LINES, 0, 1);
+    mRingWrite += count;
+    return first;
 }
 
+
+void
+draw_immediate::flush()
+{
+    if (mBatches.empty()) {
+        return;
+    }
+
+    uint32_t base = upload();
+
+    const graphics_device& device = mDevice;
+    std::shared_ptr<graphics_state> state = device.get_graphics_state();
+    matrix4_t model = device.model_transform();
+    matrix4_t camera = device.camera_transform();
+    matrix4_t projection = device.projection_transform();
+    std::shared_ptr<vertex_buffer> vb = device.get_vertex_buffer();
+
+    mDevice.set_vertex_buffer(mRing);
+    for (auto& b : mBatches) {
+        if (b.mState) {
+            mDevice.set_graphics_state(b.mState);
+        }
+        mDevice.model_transform() = b.mModelXform;
+        mDevice.camera_transform() = b.mCameraXform;
+        mDevice.projection_transform() = b.mProjectionXform;
+        mDevice.update_state();
+        mDevice.draw_primitive(b.mType, base + b.mFirst,
+            vertex_primitive_count(b.mType, b.mCount));
+    }
+
+    if (state) {
+        mDevice.set_graphics_state(std::move(state));
+    }
+    mDevice.model_transform() = model;
+    mDevice.camera_transform() = camera;
+    mDevice.projection_transform() = projection;
+    mDevice.set_vertex_buffer(std::move(vb));
+
+    mVertices.clear();
+    mBatches.clear();
 }
 
+}
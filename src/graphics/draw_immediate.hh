@@ -6,6 +6,12 @@
 
 namespace trillek {
 
+// Queues simple 2D primitives and draws them in as few calls as possible.
+// Each primitive is drawn with the graphics state and transforms that were
+// current when it was queued. Consecutive primitives which share them are
+// merged into one draw when the queue is flushed. The device flushes at the
+// end of every frame. Vertices go through one vertex buffer used as a ring,
+// which is only reallocated if a frame needs more than it holds.
 class draw_immediate {
 public:
     draw_immediate(graphics_device& pDevice);
@@ -20,8 +26,52 @@ public:
     void draw_line(const point2_t& pStart, const point2_t& pEnd,
                     const rgba_t& pColor);
 
+    // Draw everything queued so far, leaving the device's state,
+    // transforms and vertex buffer as they were.
+    void flush();
+
+    uint32_t queued_vertices() const {
+        return mVertices.size();
+    }
+
+    uint32_t queued_draws() const {
+        return mBatches.size();
+    }
+
 private:
+    struct batch {
+        primitive_type_t mType;
+        std::shared_ptr<graphics_state> mState;
+        matrix4_t mModelXform;
+        matrix4_t mCameraXform;
+        matrix4_t mProjectionXform;
+        uint32_t mFirst;
+        uint32_t mCount;
+    };
+
     graphics_device& mDevice;
+
+    std::vector<std_vtx_fmt_pc_t> mVertices;
+    std::vector<batch> mBatches;
+
+    std::shared_ptr<vertex_buffer> mRing;
+    uint32_t mRingCapacity;
+    uint32_t mRingWrite;
+
+    void begin_batch(primitive_type_t pType);
+
+    void add_vertex(float_t pX, float_t pY, const rgba_t& pColor) {
+        mVertices.push_back(
+            std_vtx_fmt_pc_t{ point3_t(pX, pY, 0.0f), pColor }
+        );
+    }
+
+    // Queue a triangle strip as independent triangles, so that it can
+    // share a draw with its neighbours.
+    void add_strip(const point2_t* pPoints, uint32_t pCount,
+            const rgba_t& pColor);
+
+    uint32_t upload();
 };
 
 }
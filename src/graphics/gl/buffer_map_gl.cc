@@ -0,0 +1,70 @@
+#include <buffer_map_gl.hh>
+#include <translate_constants_gl.hh>
+#include <extensions_gl.hh>
+
+namespace trillek { namespace gl {
+
+
+bool
+has_buffer_storage() {
+    static const bool sHasBufferStorage = version_at_least(4, 4)
+            || has_extension("GL_ARB_buffer_storage");
+    return sHasBufferStorage;
+}
+
+
+uint8_t*
+allocate_buffer(GLenum pTarget, uint32_t pBytes, buffer_lifetime_t pLifetime)
+{
+    if (pLifetime == BUFFER_DYNAMIC && pBytes > 0 && has_buffer_storage()) {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT
+                | GL_MAP_COHERENT_BIT;
+        glBufferStorage(pTarget, pBytes, NULL, flags);
+        void* data = glMapBufferRange(pTarget, 0, pBytes, flags);
+        check_gl_error("gl::allocate_buffer");
+        if (!data) {
+            throw std::runtime_error("gl::allocate_buffer");
+        }
+        return static_cast<uint8_t*>(data);
+    }
+
+    glBufferData(pTarget, pBytes, NULL,
+            translate_buffer_lifetime_gl(pLifetime));
+    return nullptr;
+}
+
+
+void*
+map_buffer_range(GLenum pTarget, buffer_lifetime_t pLifetime,
+        uint32_t pOffset, uint32_t pBytes)
+{
+    GLbitfield access = GL_MAP_WRITE_BIT;
+    switch (pLifetime) {
+    case BUFFER_STATIC:
+        access |= GL_MAP_INVALIDATE_RANGE_BIT;
+        break;
+
+    case BUFFER_DYNAMIC:
+        access |= GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+        break;
+
+    case BUFFER_VOLATILE:
+        access |= pOffset == 0
+            ? GL_MAP_INVALIDATE_BUFFER_BIT
+            : GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+        break;
+
+    default:
+        throw std::logic_error("gl::map_buffer_range");
+    }
+
+    void* data = glMapBufferRange(pTarget, pOffset, pBytes, access);
+    check_gl_error("gl::map_buffer_range");
+    if (!data) {
+        throw std::runtime_error("gl::map_buffer_range");
+    }
+    return data;
+}
+
+
+} }
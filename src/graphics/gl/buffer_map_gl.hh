@@ -0,0 +1,37 @@
+#ifndef BUFFER_MAP_GL_HH_INCLUDED
+#define BUFFER_MAP_GL_HH_INCLUDED
+
+#include <graphics_gl.hh>
+#include <graphics_constants.hh>
+
+namespace trillek { namespace gl {
+
+
+// True if the context has ARB_buffer_storage (core since GL 4.4).
+bool has_buffer_storage();
+
+
+// Allocate pBytes of storage for the buffer bound to pTarget. Dynamic
+// buffers get immutable storage which stays mapped, coherently, for the
+// buffer's lifetime if the GL supports it; the mapping is returned.
+// Otherwise this returns null and the buffer is mapped on each lock.
+uint8_t* allocate_buffer(GLenum pTarget, uint32_t pBytes,
+        buffer_lifetime_t pLifetime);
+
+
+// Map [pOffset, pOffset + pBytes) of the buffer bound to pTarget for
+// writing, discarding what was there. Only static buffers wait for the
+// GPU to finish with the range:
+//
+//  - Volatile buffers are streamed: written front to back, then started
+//    again from the beginning. Mapping from offset 0 orphans the old
+//    storage, and anything else is mapped unsynchronised.
+//  - Dynamic buffers are always mapped unsynchronised. The caller must
+//    not overwrite anything the GPU may still be drawing.
+void* map_buffer_range(GLenum pTarget, buffer_lifetime_t pLifetime,
+        uint32_t pOffset, uint32_t pBytes);
+
+
+} }
+
+#endif // BUFFER_MAP_GL_HH_INCLUDED
@@ -0,0 +1,199 @@
+#include <graphics_gl.hh>
+#include <extensions_gl.hh>
+#include <mutex>
+#include <string>
+
+namespace trillek { namespace gl {
+
+
+error_policy_t sErrorPolicy =
+#if defined(TRILLEK_GL_ERRORS_OFF)
+    ERRORS_OFF;
+#elif defined(TRILLEK_GL_ERRORS_FRAME)
+    ERRORS_PER_FRAME;
+#elif defined(TRILLEK_GL_ERRORS_DEBUG)
+    ERRORS_DEBUG_OUTPUT;
+#else
+    ERRORS_PER_CALL;
+#endif
+
+std::atomic<const char*> sErrorSite(nullptr);
+
+
+namespace {
+
+    // The first error the debug callback saw this frame. The callback may
+    // run on a driver thread, and mustn't throw through the driver.
+    std::mutex sDebugMutex;
+    std::string sDebugError;
+
+    void APIENTRY
+    debug_callback(GLenum pSource, GLenum pType, GLuint pId,
+            GLenum pSeverity, GLsizei pLength, const GLchar* pMessage,
+            const void* pUser) {
+        if (pType != GL_DEBUG_TYPE_ERROR
+                && pType != GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(sDebugMutex);
+        if (sDebugError.empty()) {
+            sDebugError = pMessage;
+            const char* site = sErrorSite.load(std::memory_order_relaxed);
+            if (site) {
+                sDebugError += std::string(" (after ") + site + ")";
+            }
+        }
+    }
+
+    // Throw away anything raised under the previous policy.
+    void
+    drain_gl_errors() {
+        for (unsigned i = 0; i < 16 && glGetError() != GL_NO_ERROR; ++i) {
+        }
+    }
+
+    void
+    enable_debug_output(bool pEnable) {
+        if (pEnable) {
+            glDebugMessageCallback(debug_callback, nullptr);
+            glEnable(GL_DEBUG_OUTPUT);
+        }
+        else {
+            glDisable(GL_DEBUG_OUTPUT);
+            glDebugMessageCallback(nullptr, nullptr);
+        }
+    }
+
+    void
+    enable_debug_output_arb(bool pEnable) {
+        glDebugMessageCallbackARB(pEnable ? debug_callback : nullptr,
+            nullptr);
+    }
+
+}
+
+
+void
+throw_gl_error(GLenum pErr, const char* pSite) {
+    const char* name;
+    switch (pErr) {
+    case GL_INVALID_ENUM:
+        name = "GL_INVALID_ENUM";
+        break;
+
+    case GL_INVALID_VALUE:
+        name = "GL_INVALID_VALUE";
+        break;
+
+    case GL_INVALID_OPERATION:
+        name = "GL_INVALID_OPERATION";
+        break;
+
+    case GL_STACK_OVERFLOW:
+        name = "GL_STACK_OVERFLOW";
+        break;
+
+    case GL_STACK_UNDERFLOW:
+        name = "GL_STACK_UNDERFLOW";
+        break;
+
+    case GL_OUT_OF_MEMORY:
+        name = "GL_OUT_OF_MEMORY";
+        break;
+
+    case GL_INVALID_FRAMEBUFFER_OPERATION:
+        name = "GL_INVALID_FRAMEBUFFER_OPERATION";
+        break;
+
+    case GL_TABLE_TOO_LARGE:
+        name = "GL_TABLE_TOO_LARGE";
+        break;
+
+    default:
+        name = "Unknown OpenGL error";
+        break;
+    }
+
+    std::string message(name);
+    if (pSite) {
+        message += std::string(" in ") + pSite;
+    }
+
+    switch (pErr) {
+    case GL_INVALID_ENUM:
+    case GL_INVALID_VALUE:
+    case GL_INVALID_OPERATION:
+    case GL_TABLE_TOO_LARGE:
+        throw std::invalid_argument(message);
+
+    case GL_OUT_OF_MEMORY:
+        throw std::runtime_error(message);
+
+    default:
+        throw std::logic_error(message);
+    }
+}
+
+
+error_policy_t
+set_error_policy(error_policy_t pPolicy) {
+    static const bool sHasKhrDebug = version_at_least(4, 3)
+            || has_extension("GL_KHR_debug");
+    static const bool sHasArbDebug = !sHasKhrDebug
+            && has_extension("GL_ARB_debug_output");
+
+    if (pPolicy == ERRORS_DEBUG_OUTPUT && !sHasKhrDebug && !sHasArbDebug) {
+        pPolicy = ERRORS_PER_FRAME;
+    }
+
+    bool debug = pPolicy == ERRORS_DEBUG_OUTPUT;
+    if (sHasKhrDebug) {
+        enable_debug_output(debug);
+    }
+    else if (sHasArbDebug) {
+        enable_debug_output_arb(debug);
+    }
+
+    drain_gl_errors();
+    sErrorPolicy = pPolicy;
+    sErrorSite.store(nullptr, std::memory_order_relaxed);
+    return pPolicy;
+}
+
+
+void
+check_frame_errors() {
+    switch (sErrorPolicy) {
+    case ERRORS_PER_FRAME: {
+        GLenum err = glGetError();
+        if (err != GL_NO_ERROR) {
+            drain_gl_errors();
+            std::string site("this frame");
+            if (const char* last = sErrorSite.load(std::memory_order_relaxed)) {
+                site += std::string(", after ") + last;
+            }
+            throw_gl_error(err, site.c_str());
+        }
+        break;
+    }
+
+    case ERRORS_DEBUG_OUTPUT: {
+        std::string error;
+        {
+            std::lock_guard<std::mutex> lock(sDebugMutex);
+            error.swap(sDebugError);
+        }
+        if (!error.empty()) {
+            throw std::logic_error(error);
+        }
+        break;
+    }
+
+    default:
+        break;
+    }
+    sErrorSite.store(nullptr, std::memory_order_relaxed);
+}
+
+
+} }
@@ -0,0 +1,46 @@
+#include <extensions_gl.hh>
+#include <cstring>
+#include <cstdio>
+
+namespace trillek { namespace gl {
+
+
+bool
+version_at_least(int pMajor, int pMinor) {
+    const char* version = (const char*)glGetString(GL_VERSION);
+    int major = 0, minor = 0;
+    if (!version || std::sscanf(version, "%d.%d", &major, &minor) != 2) {
+        return false;
+    }
+    return major > pMajor || (major == pMajor && minor >= pMinor);
+}
+
+
+bool
+has_extension(const char* pName) {
+    // Core profiles can only list extensions one at a time.
+    if (version_at_least(3, 0)) {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; ++i) {
+            const char* ext = (const char*)glGetStringi(GL_EXTENSIONS, i);
+            if (ext && std::strcmp(ext, pName) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    const char* exts = (const char*)glGetString(GL_EXTENSIONS);
+    size_t length = std::strlen(pName);
+    for (const char* p = exts; p && (p = std::strstr(p, pName)); p += length) {
+        if ((p == exts || p[-1] == ' ')
+                && (p[length] == ' ' || p[length] == '\0')) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+} }
@@ -0,0 +1,19 @@
+#ifndef EXTENSIONS_GL_HH_INCLUDED
+#define EXTENSIONS_GL_HH_INCLUDED
+
+#include <graphics_gl.hh>
+
+namespace trillek { namespace gl {
+
+
+// True if the current context's GL version is at least pMajor.pMinor.
+bool version_at_least(int pMajor, int pMinor);
+
+
+// True if the current context lists pName, e.g. "GL_KHR_debug".
+bool has_extension(const char* pName);
+
+
+} }
+
+#endif // EXTENSIONS_GL_HH_INCLUDED
@@ -2,78 +2,137 @@
 #include <graphics_device_gl.hh>
 #include <translate_constants_gl.hh>
 #include <vertex_buffer_gl.hh>
+#include <index_buffer_gl.hh>
 #include <vertex_format_gl.hh>
 #include <graphics_state.hh>
 #include <mesh_gl.hh>
+#include <transient_arena_gl.hh>
+#include <algorithm>
 
 namespace trillek {
 
 namespace gl {
 
-    void
-    throw_gl_error(GLuint err) {
-        switch (err) {
-        case GL_INVALID_ENUM:
-            throw std::invalid_argument("GL_INVALID_ENUM");
-
-        case GL_INVALID_VALUE:
-            throw std::invalid_argument("GL_INVALID_VALUE");
-
-        case GL_INVALID_OPERATION:
-            throw std::invalid_argument("GL_INVALID_OPERATION");
+    state_shadow* sCurrentShadow = nullptr;
 
-        case GL_STACK_OVERFLOW:
-            throw std::logic_error("GL_STACK_OVERFLOW");
-
-        case GL_STACK_UNDERFLOW:
-            throw std::logic_error("GL_STACK_UNDERFLOW");
+}
 
-        case GL_OUT_OF_MEMORY:
-            throw std::runtime_error("GL_OUT_OF_MEMORY");
+namespace {
 
-        case GL_INVALID_FRAMEBUFFER_OPERATION:
-            throw std::logic_error("GL_INVALID_FRAMEBUFFER_OPERATION");
+    // Room for a few thousand draws per frame; a frame which needs more
+    // moves on to the next region early.
+    const uint32_t UNIFORM_RING_BYTES_PER_FRAME = 1u << 20;
+    const uint32_t UNIFORM_RING_FRAMES = 3;
 
-        case GL_TABLE_TOO_LARGE:
-            throw std::invalid_argument("GL_TABLE_TOO_LARGE");
+    const float_t sWhite[4] = { 1, 1, 1, 1 };
 
-        default:
-            throw std::logic_error("Unknown OpenGL error");
+    // The core profile can only draw these once they're triangulated,
+    // which indexed_mesh_builder::begin() and end() do.
+    void
+    check_core_primitive_type(primitive_type_t pType) {
+        if (pType == PRIM_POLYGON || pType == PRIM_QUADS
+                || pType == PRIM_QUAD_STRIP) {
+            throw std::invalid_argument("graphics_device_gl: polygons and "
+                "quads must be triangulated");
         }
     }
 
+    // draw_instanced streams instance_t as a mat4 and a vec4.
+    static_assert(sizeof(instance_t) == 20 * sizeof(float_t),
+        "instance_t must be tightly packed");
+
 }
 
 
 graphics_device_gl::graphics_device_gl()
 {
+    gl::sCurrentShadow = &mShadow;
+    gl::set_error_policy(gl::sErrorPolicy);
+
+    mProgram = make_standard_program_gl();
+    mInstancedProgram = make_standard_program_gl(true);
+
+    mUniformRing = std::unique_ptr<transient_arena_gl>(
+        new transient_arena_gl(UNIFORM_RING_BYTES_PER_FRAME,
+            UNIFORM_RING_FRAMES)
+    );
+    GLint align;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &align);
+    mUniformAlign = std::max<GLint>(align, 16);
+
+    // What the fixed function pipeline used for missing attributes.
+    glVertexAttrib3f(ATTRIB_NORMAL, 0, 0, 1);
+    glVertexAttrib4f(ATTRIB_COLOR, 1, 1, 1, 1);
+    gl::check_gl_error("graphics_device_gl");
+
     init();
 }
 
 
 graphics_device_gl::~graphics_device_gl()
 {
+    mProgram.reset();
+    mInstancedProgram.reset();
+    mUniformRing.reset();
+    if (gl::sCurrentShadow == &mShadow) {
+        gl::sCurrentShadow = nullptr;
+    }
 }
 
 
 void
 graphics_device_gl::update_transforms_internal(bool pForce)
 {
-    if (mModelXformDirty || mCameraXformDirty || pForce) {
-        glMatrixMode(GL_MODELVIEW);
+    if (mModelXformDirty || mCameraXformDirty || mProjectionXformDirty
+            || pForce) {
         mModelViewXform = mModelXform[mModelXformSP];
         mModelViewXform *= mCameraXform;
-        glLoadMatrixf(&mModelViewXform.mM[0][0]);
+        upload_draw_block(sWhite);
         mModelXformDirty = false;
         mCameraXformDirty = false;
+        mProjectionXformDirty = false;
     }
+}
 
-    if (mProjectionXformDirty || pForce) {
-        glMatrixMode(GL_PROJECTION);
-        glLoadMatrixf(&mProjectionXform.mM[0][0]);
-        mProjectionXformDirty = false;
-        glMatrixMode(GL_MODELVIEW);
+
+// Fill in the per_draw block from mModelViewXform, the projection and the
+// tint. The block is written straight into the ring, and stays bound for
+// every draw until the transforms next change.
+void
+graphics_device_gl::upload_draw_block(const float_t* pTint)
+{
+    uint32_t bytes = sizeof(draw_block_gl);
+    if (mUniformRing->used_bytes() + mUniformAlign + bytes
+            > mUniformRing->region_bytes()) {
+        mUniformRing->end_frame();
+        mUniformRing->begin_frame();
+    }
+
+    // Without a persistent mapping, mapping the ring for every block
+    // would cost more than the upload, so blocks are built on the stack
+    // and copied in with glBufferSubData.
+    bool mapped = mUniformRing->persistent();
+    uint32_t offset;
+    draw_block_gl staged;
+    draw_block_gl* block = &staged;
+    if (mapped) {
+        block = static_cast<draw_block_gl*>(
+            mUniformRing->allocate(bytes, mUniformAlign, &offset));
+    }
+    else {
+        offset = mUniformRing->reserve(bytes, mUniformAlign);
+    }
+    block->mModelView = mModelViewXform;
+    block->mModelViewProjection = mProjectionXform * mModelViewXform;
+    block->mNormal = matrix4_t(matrix3_t(dual_space(mModelViewXform)));
+    std::copy(pTint, pTint + 4, block->mTint);
+
+    if (!mapped) {
+        gl::bind_buffer(GL_UNIFORM_BUFFER, mUniformRing->handle());
+        glBufferSubData(GL_UNIFORM_BUFFER, offset, bytes, block);
     }
+    gl::bind_buffer_range(GL_UNIFORM_BUFFER, BLOCK_DRAW,
+            mUniformRing->handle(), offset, bytes);
 }
 
 
@@ -82,22 +141,17 @@ namespace {
 inline void
 toggle_gl_state(bool pFlag, GLenum pGlFlag)
 {
-    if (pFlag) {
-        glEnable(pGlFlag);
-    }
-    else {
-        glDisable(pGlFlag);
-    }
+    gl::set_enabled(pGlFlag, pFlag);
 }
 
 
 inline void
 update_depth_bias_gl(float_t pBias) {
     if (pBias == 0) {
-        glDisable(GL_POLYGON_OFFSET_FILL);
+        gl::set_enabled(GL_POLYGON_OFFSET_FILL, false);
     }
     else {
-        glEnable(GL_POLYGON_OFFSET_FILL);
+        gl::set_enabled(GL_POLYGON_OFFSET_FILL, true);
         glPolygonOffset(pBias, pBias);
     }
 }
@@ -176,6 +230,12 @@ graphics_device_gl::update_vertex_buffer_internal()
     if (mCurrVB) {
         mCurrVB->select();
     }
+
+    // Index buffer bindings live in the vertex array object, so rebind
+    // the current one into the new one.
+    if (mCurrIB) {
+        mIndexBufferDirty = true;
+    }
 }
 
 
@@ -235,8 +295,15 @@ graphics_device_gl::make_vertex_format(std::string pName) {
 
 
 
+// Transient data written since the last draw has to be unmapped before
+// the GL will read it.
 inline void
-graphics_device_gl::pre_draw_primitive() {
+graphics_device_gl::pre_draw_primitive(shader_program_gl& pProgram) {
+    if (transient_arena* arena = get_transient_arena()) {
+        arena->unmap();
+    }
+    mUniformRing->unmap();
+    pProgram.select();
 }
 
 
@@ -252,7 +319,7 @@ void
 graphics_device_gl::draw_primitive(primitive_type_t pType,
         uint32_t pVertexStart, uint32_t pPrimitiveCount)
 {
-    pre_draw_primitive();
+    pre_draw_primitive(*mProgram);
 
     glDrawArrays(translate_primitive_type_gl(pType), pVertexStart,
         translate_index_count_gl(pType, pPrimitiveCount));
@@ -261,13 +328,140 @@ graphics_device_gl::draw_primitive(primitive_type_t pType,
 }
 
 
+void
+graphics_device_gl::draw_primitive_ranges(primitive_type_t pType,
+        const uint32_t* pVertexStarts, const uint32_t* pPrimitiveCounts,
+        uint32_t pRanges)
+{
+    pre_draw_primitive(*mProgram);
+
+    mMultiFirst.resize(pRanges);
+    mMultiCount.resize(pRanges);
+    uint32_t primitives = 0;
+    for (uint32_t i = 0; i < pRanges; ++i) {
+        mMultiFirst[i] = pVertexStarts[i];
+        mMultiCount[i] = translate_index_count_gl(pType, pPrimitiveCounts[i]);
+        primitives += pPrimitiveCounts[i];
+    }
+    glMultiDrawArrays(translate_primitive_type_gl(pType), mMultiFirst.data(),
+        mMultiCount.data(), pRanges);
+
+    post_draw_primitive(primitives);
+}
+
+
+void
+graphics_device_gl::draw_indexed_primitive(primitive_type_t pType,
+        index_type_t pIndexType, uint32_t pIndexStart,
+        uint32_t pPrimitiveCount)
+{
+    pre_draw_primitive(*mProgram);
+
+    uintptr_t offset = pIndexStart * index_type_size(pIndexType);
+    glDrawElements(translate_primitive_type_gl(pType),
+        translate_index_count_gl(pType, pPrimitiveCount),
+        translate_index_type_gl(pIndexType), (const GLvoid*)offset);
+
+    post_draw_primitive(pPrimitiveCount);
+}
+
+
+// The instances go into the transient arena as a stream of instance_t,
+// with the camera folded into each transform, and are read through
+// per-instance attributes. The whole call is then a single instanced draw
+// (one per range for batched meshes, which GL 3.3 can't multi-draw
+// instanced), with the per_draw block carrying only the projection.
+void
+graphics_device_gl::draw_instanced(mesh& pMesh,
+        const instance_t* pInstances, uint32_t pCount)
+{
+    if (pCount == 0) {
+        return;
+    }
+    bool tint = !pMesh.get_vertex_buffer()->format().has_color();
+
+    transient_arena_gl& arena
+        = static_cast<transient_arena_gl&>(use_transient_arena());
+    uint32_t offset;
+    instance_t* stream = static_cast<instance_t*>(arena.allocate(
+        sizeof(instance_t) * pCount, 16, &offset));
+    for (uint32_t i = 0; i < pCount; ++i) {
+        stream[i].mTransform = pInstances[i].mTransform;
+        stream[i].mTransform *= mCameraXform;
+        const float_t* color = tint ? pInstances[i].mColor : sWhite;
+        std::copy(color, color + 4, stream[i].mColor);
+    }
+
+    mModelViewXform = matrix4_t();
+    upload_draw_block(sWhite);
+
+    gl::select_guard<mesh> sel(pMesh);
+    gl::bind_buffer(GL_ARRAY_BUFFER, arena.handle());
+    for (GLuint i = ATTRIB_INSTANCE_TRANSFORM; i < ATTRIB_LAST; ++i) {
+        uintptr_t column = offset
+            + (i - ATTRIB_INSTANCE_TRANSFORM) * 4 * sizeof(float_t);
+        glEnableVertexAttribArray(i);
+        glVertexAttribPointer(i, 4, GL_FLOAT, GL_FALSE, sizeof(instance_t),
+            (const GLvoid*)column);
+        glVertexAttribDivisor(i, 1);
+    }
+
+    pre_draw_primitive(*mInstancedProgram);
+
+    GLenum type = translate_primitive_type_gl(pMesh.primitive_type());
+    if (pMesh.indexed()) {
+        index_type_t indexType = pMesh.get_index_buffer()->index_type();
+        uintptr_t start = pMesh.index_start() * index_type_size(indexType);
+        glDrawElementsInstanced(type,
+            translate_index_count_gl(pMesh.primitive_type(),
+                pMesh.primitive_count()),
+            translate_index_type_gl(indexType), (const GLvoid*)start,
+            pCount);
+        post_draw_primitive(pMesh.primitive_count() * pCount);
+    }
+    else if (pMesh.range_count()) {
+        for (uint32_t r = 0; r < pMesh.range_count(); ++r) {
+            uint32_t primitives = pMesh.range_primitive_counts()[r];
+            glDrawArraysInstanced(type, pMesh.range_starts()[r],
+                translate_index_count_gl(pMesh.primitive_type(), primitives),
+                pCount);
+            post_draw_primitive(primitives * pCount);
+        }
+    }
+    else {
+        glDrawArraysInstanced(type, pMesh.vertex_start(),
+            translate_index_count_gl(pMesh.primitive_type(),
+                pMesh.primitive_count()),
+            pCount);
+        post_draw_primitive(pMesh.primitive_count() * pCount);
+    }
+
+    // The mesh's vertex array goes back to having no instance arrays.
+    for (GLuint i = ATTRIB_INSTANCE_TRANSFORM; i < ATTRIB_LAST; ++i) {
+        glDisableVertexAttribArray(i);
+    }
+
+    // The model transform is no longer loaded.
+    mModelXformDirty = true;
+    mAnythingDirty = true;
+}
+
+
 void
 graphics_device_gl::begin_frame_internal() {
+    gl::check_frame_errors();
+    mUniformRing->begin_frame();
+
+    // The bound block may be in the region just reused.
+    mModelXformDirty = true;
+    mAnythingDirty = true;
 }
 
 
 void
 graphics_device_gl::end_frame_internal() {
+    mUniformRing->end_frame();
+    gl::check_frame_errors();
 }
 
 
@@ -296,16 +490,23 @@ std::unique_ptr<texture_target> make_texture_target();
 
 #endif
 
-#if 0
-
 std::unique_ptr<index_buffer>
-graphics_device_gl::make_index_buffer(buffer_lifetime_t pLifetime,
-            unsigned pIndexCount) {
+graphics_device_gl::make_index_buffer(index_type_t pType,
+            uint32_t pIndexCount, buffer_lifetime_t pLifetime) {
     return std::unique_ptr<index_buffer>(
-        new index_buffer_gl(pLifetime, pIndexCount)
+        new index_buffer_gl(pLifetime, pType, pIndexCount)
     );
 }
-#endif
+
+
+std::unique_ptr<transient_arena>
+graphics_device_gl::make_transient_arena(uint32_t pRegionBytes,
+            uint32_t pRegions) {
+    return std::unique_ptr<transient_arena>(
+        new transient_arena_gl(pRegionBytes, pRegions)
+    );
+}
+
 
 std::unique_ptr<vertex_buffer>
 graphics_device_gl::make_vertex_buffer(std::shared_ptr<vertex_format> pFormat,
@@ -320,6 +521,7 @@ std::unique_ptr<mesh>
 graphics_device_gl::make_mesh(primitive_type_t pType,
             const std::shared_ptr<vertex_format>& pFormat,
             uint32_t pPrimitiveCount, buffer_lifetime_t pLifetime) {
+    check_core_primitive_type(pType);
     return std::unique_ptr<mesh>(
         new mesh_gl(shared_from_this(), pLifetime, pType,
                 std::static_pointer_cast<vertex_format_gl>(pFormat),
@@ -328,5 +530,32 @@ graphics_device_gl::make_mesh(primitive_type_t pType,
 }
 
 
+std::unique_ptr<mesh>
+graphics_device_gl::make_batch_mesh(primitive_type_t pType,
+            const std::shared_ptr<vertex_format>& pFormat,
+            const std::vector<uint32_t>& pPrimitiveCounts,
+            buffer_lifetime_t pLifetime) {
+    check_core_primitive_type(pType);
+    return std::unique_ptr<mesh>(
+        new mesh_gl(shared_from_this(), pLifetime, pType,
+                std::static_pointer_cast<vertex_format_gl>(pFormat),
+                pPrimitiveCounts)
+    );
 }
 
+
+std::unique_ptr<mesh>
+graphics_device_gl::make_indexed_mesh(primitive_type_t pType,
+            const std::shared_ptr<vertex_format>& pFormat,
+            uint32_t pVertexCount, index_type_t pIndexType,
+            uint32_t pIndexCount, buffer_lifetime_t pLifetime) {
+    check_core_primitive_type(pType);
+    return std::unique_ptr<mesh>(
+        new mesh_gl(shared_from_this(), pLifetime, pType,
+                std::static_pointer_cast<vertex_format_gl>(pFormat),
+                pVertexCount, pIndexType, pIndexCount)
+    );
+}
+
+
+}
@@ -3,6 +3,8 @@
 
 #include <graphics_gl.hh>
 #include <graphics_device.hh>
+#include <shader_program_gl.hh>
+#include <transient_arena_gl.hh>
 
 namespace trillek {
 
@@ -23,12 +25,42 @@ namespace trillek {
                 const std::shared_ptr<vertex_format>& pFmt,
                 uint32_t mCount, buffer_lifetime_t pLifetime);
 
+        virtual std::unique_ptr<mesh>
+        make_batch_mesh(primitive_type_t pType,
+                const std::shared_ptr<vertex_format>& pFmt,
+                const std::vector<uint32_t>& pPrimitiveCounts,
+                buffer_lifetime_t pLifetime);
+
+        virtual std::unique_ptr<mesh>
+        make_indexed_mesh(primitive_type_t pType,
+                const std::shared_ptr<vertex_format>& pFmt,
+                uint32_t pVertexCount, index_type_t pIndexType,
+                uint32_t pIndexCount, buffer_lifetime_t pLifetime);
+
         virtual std::unique_ptr<vertex_buffer>
         make_vertex_buffer(std::shared_ptr<vertex_format> pFmt,
                 uint32_t pVertCount, buffer_lifetime_t pLifetime);
 
+        virtual std::unique_ptr<index_buffer>
+        make_index_buffer(index_type_t pType, uint32_t pIndexCount,
+                buffer_lifetime_t pLifetime);
+
+        virtual std::unique_ptr<transient_arena>
+        make_transient_arena(uint32_t pRegionBytes, uint32_t pRegions);
+
         virtual void draw_primitive(primitive_type_t pType, uint32_t pVertexStart, uint32_t pPrimitiveCount);
 
+        virtual void draw_primitive_ranges(primitive_type_t pType,
+                const uint32_t* pVertexStarts,
+                const uint32_t* pPrimitiveCounts, uint32_t pRanges);
+
+        virtual void draw_indexed_primitive(primitive_type_t pType,
+                index_type_t pIndexType, uint32_t pIndexStart,
+                uint32_t pPrimitiveCount);
+
+        virtual void draw_instanced(mesh& pMesh,
+                const instance_t* pInstances, uint32_t pCount);
+
         virtual std::shared_ptr<window_target> make_window_target(
                 const std::shared_ptr<window>& pWindow);
 
@@ -54,10 +86,33 @@ namespace trillek {
 
         virtual void update_viewport_internal();
 
+        // The GL state as last set through this device's context.
+        gl::state_shadow& shadow() {
+            return mShadow;
+        }
+
     private:
+        gl::state_shadow mShadow;
+
         matrix4_t mModelViewXform;
 
-        void pre_draw_primitive();
+        // Everything is drawn with mProgram, or mInstancedProgram for
+        // draw_instanced. Each draw's block is written
+        // to a fresh slice of mUniformRing, which is bound with
+        // glBindBufferRange, so nothing is ever overwritten while the GPU
+        // may still be reading it.
+        std::unique_ptr<shader_program_gl> mProgram;
+        std::unique_ptr<shader_program_gl> mInstancedProgram;
+        std::unique_ptr<transient_arena_gl> mUniformRing;
+        uint32_t mUniformAlign;
+
+        void upload_draw_block(const float_t* pTint);
+
+        // Scratch arrays for glMultiDrawArrays.
+        std::vector<GLint> mMultiFirst;
+        std::vector<GLsizei> mMultiCount;
+
+        void pre_draw_primitive(shader_program_gl& pProgram);
         void post_draw_primitive(uint32_t pPrimitiveCount);
     };
 
@@ -2,6 +2,8 @@
 #define GRAPHICS_GL_HH_INCLUDED
 
 #include <utils.hh>
+#include <stdexcept>
+#include <atomic>
 
 #ifdef __gl_h_
 #error gl.h included before graphics_gl.hh
@@ -36,14 +38,51 @@
 namespace trillek { namespace gl {
 
 
-extern void throw_gl_error(GLenum pErr);
+// When GL errors are looked for. glGetError waits for the driver to
+// catch up, so only ERRORS_PER_CALL checks after individual calls.
+enum error_policy_t {
+    ERRORS_OFF = 0,
+    ERRORS_PER_CALL,
+    ERRORS_PER_FRAME,
+
+    // KHR_debug (or ARB_debug_output) reports errors to a callback, which
+    // keeps the first for the end of the frame. Falls back to
+    // ERRORS_PER_FRAME where neither is supported.
+    ERRORS_DEBUG_OUTPUT
+};
+
+
+extern error_policy_t sErrorPolicy;
+
+// The last place which checked for errors, to say roughly where an error
+// that is only found later came from. The debug callback may read it from
+// a driver thread. Sites are string literals, so relaxed access is enough.
+extern std::atomic<const char*> sErrorSite;
+
+
+// Throws the exception for pErr, naming pSite if given.
+extern void throw_gl_error(GLenum pErr, const char* pSite = nullptr);
+
+
+// Switches the current context to pPolicy, and returns the policy it
+// actually got.
+error_policy_t set_error_policy(error_policy_t pPolicy);
+
+
+// Throw any error which the policy has let pile up.
+void check_frame_errors();
 
 
 inline void
-check_gl_error() {
-    GLuint err = glGetError();
-    if (err != GL_NO_ERROR) {
-        throw_gl_error(err);
+check_gl_error(const char* pSite = nullptr) {
+    if (sErrorPolicy == ERRORS_PER_CALL) {
+        GLuint err = glGetError();
+        if (err != GL_NO_ERROR) {
+            throw_gl_error(err, pSite);
+        }
+    }
+    else if (pSite) {
+        sErrorSite.store(pSite, std::memory_order_relaxed);
     }
 }
 
@@ -65,23 +104,308 @@ struct select_guard {
 };
 
 
+// A CPU-side copy of the GL bindings and capabilities which the engine
+// changes. While a shadow is current, the functions below skip binds and
+// enables which would change nothing, and answer queries without a round
+// trip to the driver. Anything which changes this state behind their back
+// must invalidate() the shadow.
+//
+// Vertex array enables and pointers aren't shadowed: they belong to the
+// vertex array objects, which are recorded once.
+struct state_shadow {
+    enum binding_t {
+        BIND_ARRAY_BUFFER = 0,
+        BIND_ELEMENT_ARRAY_BUFFER,
+        BIND_UNIFORM_BUFFER,
+        BIND_VERTEX_ARRAY,
+        BIND_READ_FRAMEBUFFER,
+        BIND_DRAW_FRAMEBUFFER,
+        BIND_PROGRAM,
+        BIND_LAST
+    };
+
+    enum cap_t {
+        CAP_DEPTH_TEST = 0,
+        CAP_CULL_FACE,
+        CAP_POLYGON_OFFSET_FILL,
+        CAP_BLEND,
+        CAP_LAST
+    };
+
+    enum {
+        UNKNOWN = ~0u
+    };
+
+    GLuint mBindings[BIND_LAST];
+    GLuint mCaps[CAP_LAST];
+
+    state_shadow()
+    {
+        invalidate();
+    }
+
+    void invalidate()
+    {
+        for (auto& b : mBindings) {
+            b = UNKNOWN;
+        }
+        for (auto& c : mCaps) {
+            c = UNKNOWN;
+        }
+    }
+};
+
+
+// The shadow of the current context, if any. Set by graphics_device_gl.
+extern state_shadow* sCurrentShadow;
+
+
+namespace detail {
+
+    inline GLenum
+    binding_query(state_shadow::binding_t pBinding) {
+        switch (pBinding) {
+        case state_shadow::BIND_ARRAY_BUFFER:
+            return GL_ARRAY_BUFFER_BINDING;
+        case state_shadow::BIND_ELEMENT_ARRAY_BUFFER:
+            return GL_ELEMENT_ARRAY_BUFFER_BINDING;
+        case state_shadow::BIND_UNIFORM_BUFFER:
+            return GL_UNIFORM_BUFFER_BINDING;
+        case state_shadow::BIND_VERTEX_ARRAY:
+            return GL_VERTEX_ARRAY_BINDING;
+        case state_shadow::BIND_READ_FRAMEBUFFER:
+            return GL_READ_FRAMEBUFFER_BINDING;
+        case state_shadow::BIND_DRAW_FRAMEBUFFER:
+            return GL_DRAW_FRAMEBUFFER_BINDING;
+        case state_shadow::BIND_PROGRAM:
+            return GL_CURRENT_PROGRAM;
+        default:
+            throw std::logic_error("gl::detail::binding_query");
+        }
+    }
+
+    inline void
+    bind_gl(state_shadow::binding_t pBinding, GLuint pObject) {
+        switch (pBinding) {
+        case state_shadow::BIND_ARRAY_BUFFER:
+            glBindBuffer(GL_ARRAY_BUFFER, pObject);
+            break;
+        case state_shadow::BIND_ELEMENT_ARRAY_BUFFER:
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pObject);
+            break;
+        case state_shadow::BIND_UNIFORM_BUFFER:
+            glBindBuffer(GL_UNIFORM_BUFFER, pObject);
+            break;
+        case state_shadow::BIND_VERTEX_ARRAY:
+            glBindVertexArray(pObject);
+            break;
+        case state_shadow::BIND_READ_FRAMEBUFFER:
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, pObject);
+            break;
+        case state_shadow::BIND_DRAW_FRAMEBUFFER:
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, pObject);
+            break;
+        case state_shadow::BIND_PROGRAM:
+            glUseProgram(pObject);
+            break;
+        default:
+            throw std::logic_error("gl::detail::bind_gl");
+        }
+    }
+
+    inline state_shadow::binding_t
+    buffer_binding(GLenum pTarget) {
+        switch (pTarget) {
+        case GL_ARRAY_BUFFER:
+            return state_shadow::BIND_ARRAY_BUFFER;
+        case GL_ELEMENT_ARRAY_BUFFER:
+            return state_shadow::BIND_ELEMENT_ARRAY_BUFFER;
+        case GL_UNIFORM_BUFFER:
+            return state_shadow::BIND_UNIFORM_BUFFER;
+        default:
+            throw std::logic_error("gl::detail::buffer_binding");
+        }
+    }
+
+    inline state_shadow::cap_t
+    cap_index(GLenum pCap) {
+        switch (pCap) {
+        case GL_DEPTH_TEST:
+            return state_shadow::CAP_DEPTH_TEST;
+        case GL_CULL_FACE:
+            return state_shadow::CAP_CULL_FACE;
+        case GL_POLYGON_OFFSET_FILL:
+            return state_shadow::CAP_POLYGON_OFFSET_FILL;
+        case GL_BLEND:
+            return state_shadow::CAP_BLEND;
+        default:
+            return state_shadow::CAP_LAST;
+        }
+    }
+
+}
+
+
+inline GLuint
+bound(state_shadow::binding_t pBinding) {
+    state_shadow* shadow = sCurrentShadow;
+    if (shadow && shadow->mBindings[pBinding] != state_shadow::UNKNOWN) {
+        return shadow->mBindings[pBinding];
+    }
+    GLint object = 0;
+    glGetIntegerv(detail::binding_query(pBinding), &object);
+    if (shadow) {
+        shadow->mBindings[pBinding] = object;
+    }
+    return object;
+}
+
+
+inline void
+bind(state_shadow::binding_t pBinding, GLuint pObject) {
+    state_shadow* shadow = sCurrentShadow;
+    if (shadow) {
+        if (shadow->mBindings[pBinding] == pObject) {
+            return;
+        }
+        shadow->mBindings[pBinding] = pObject;
+
+        // The element array binding belongs to the vertex array object.
+        if (pBinding == state_shadow::BIND_VERTEX_ARRAY) {
+            shadow->mBindings[state_shadow::BIND_ELEMENT_ARRAY_BUFFER]
+                = state_shadow::UNKNOWN;
+        }
+    }
+    detail::bind_gl(pBinding, pObject);
+}
+
+
+// Deleting a bound object binds 0 in its place.
+inline void
+forget(state_shadow::binding_t pBinding, GLuint pObject) {
+    state_shadow* shadow = sCurrentShadow;
+    if (shadow && shadow->mBindings[pBinding] == pObject) {
+        shadow->mBindings[pBinding] = 0;
+        if (pBinding == state_shadow::BIND_VERTEX_ARRAY) {
+            shadow->mBindings[state_shadow::BIND_ELEMENT_ARRAY_BUFFER]
+                = state_shadow::UNKNOWN;
+        }
+    }
+}
+
+
+inline void
+bind_buffer(GLenum pTarget, GLuint pBuffer) {
+    bind(detail::buffer_binding(pTarget), pBuffer);
+}
+
+
+// Bind a range of pBuffer to an indexed binding point. This binds pBuffer
+// to the generic pTarget binding as well.
+inline void
+bind_buffer_range(GLenum pTarget, GLuint pIndex, GLuint pBuffer,
+        GLintptr pOffset, GLsizeiptr pSize) {
+    if (state_shadow* shadow = sCurrentShadow) {
+        shadow->mBindings[detail::buffer_binding(pTarget)] = pBuffer;
+    }
+    glBindBufferRange(pTarget, pIndex, pBuffer, pOffset, pSize);
+}
+
+
+inline void
+delete_buffer(GLuint pBuffer) {
+    forget(state_shadow::BIND_ARRAY_BUFFER, pBuffer);
+    forget(state_shadow::BIND_ELEMENT_ARRAY_BUFFER, pBuffer);
+    forget(state_shadow::BIND_UNIFORM_BUFFER, pBuffer);
+    glDeleteBuffers(1, &pBuffer);
+}
+
+
+inline void
+bind_vertex_array(GLuint pArray) {
+    bind(state_shadow::BIND_VERTEX_ARRAY, pArray);
+}
+
+
+inline void
+delete_vertex_array(GLuint pArray) {
+    forget(state_shadow::BIND_VERTEX_ARRAY, pArray);
+    glDeleteVertexArrays(1, &pArray);
+}
+
+
+// GL_FRAMEBUFFER binds both the read and the draw framebuffer.
+inline void
+bind_framebuffer(GLenum pTarget, GLuint pFramebuffer) {
+    if (pTarget != GL_DRAW_FRAMEBUFFER) {
+        bind(state_shadow::BIND_READ_FRAMEBUFFER, pFramebuffer);
+    }
+    if (pTarget != GL_READ_FRAMEBUFFER) {
+        bind(state_shadow::BIND_DRAW_FRAMEBUFFER, pFramebuffer);
+    }
+}
+
+
+inline void
+delete_framebuffer(GLuint pFramebuffer) {
+    forget(state_shadow::BIND_READ_FRAMEBUFFER, pFramebuffer);
+    forget(state_shadow::BIND_DRAW_FRAMEBUFFER, pFramebuffer);
+    glDeleteFramebuffers(1, &pFramebuffer);
+}
+
+
+inline void
+use_program(GLuint pProgram) {
+    bind(state_shadow::BIND_PROGRAM, pProgram);
+}
+
+
+inline bool
+is_enabled(GLenum pCap) {
+    state_shadow* shadow = sCurrentShadow;
+    state_shadow::cap_t cap = detail::cap_index(pCap);
+    if (!shadow || cap == state_shadow::CAP_LAST) {
+        return glIsEnabled(pCap);
+    }
+    if (shadow->mCaps[cap] == state_shadow::UNKNOWN) {
+        shadow->mCaps[cap] = glIsEnabled(pCap) ? 1 : 0;
+    }
+    return shadow->mCaps[cap] != 0;
+}
+
+
+inline void
+set_enabled(GLenum pCap, bool pEnabled) {
+    state_shadow* shadow = sCurrentShadow;
+    state_shadow::cap_t cap = detail::cap_index(pCap);
+    if (shadow && cap != state_shadow::CAP_LAST) {
+        GLuint value = pEnabled ? 1 : 0;
+        if (shadow->mCaps[cap] == value) {
+            return;
+        }
+        shadow->mCaps[cap] = value;
+    }
+    if (pEnabled) {
+        glEnable(pCap);
+    } else {
+        glDisable(pCap);
+    }
+}
+
+
 class preserve_flag
 {
 public: 
     ~preserve_flag()
     {
-        if (mEnabled) {
-            glEnable(mCap);
-        } else {
-            glDisable(mCap);
-        }
+        set_enabled(mCap, mEnabled);
     }
 
 protected:
     preserve_flag(GLenum pCap)
         : mCap(pCap)
     {
-        mEnabled = glIsEnabled(pCap);
+        mEnabled = is_enabled(pCap);
     }
 
 private:
@@ -115,23 +439,40 @@ private:
 };
 
 
-class preserve_index_buffer : public preserve<GLuint> {
+// Restores a shadowed binding on scope exit.
+class preserve_binding
+{
+public:
+    ~preserve_binding()
+    {
+        bind(mBinding, mPreserved);
+    }
+
+protected:
+    preserve_binding(state_shadow::binding_t pBinding)
+        : mBinding(pBinding), mPreserved(bound(pBinding))
+    {
+    }
+
+private:
+    state_shadow::binding_t mBinding;
+    GLuint mPreserved;
+};
+
+
+class preserve_index_buffer : public preserve_binding {
 public:
     preserve_index_buffer()
-        : preserve(GL_ELEMENT_ARRAY_BUFFER,
-                   GL_ELEMENT_ARRAY_BUFFER_BINDING,
-                   glBindBuffer)
+        : preserve_binding(state_shadow::BIND_ELEMENT_ARRAY_BUFFER)
     {
     }
 };
 
 
-class preserve_vertex_buffer : public preserve<GLuint> {
+class preserve_vertex_buffer : public preserve_binding {
 public:
     preserve_vertex_buffer()
-        : preserve(GL_ARRAY_BUFFER,
-                      GL_ARRAY_BUFFER_BINDING,
-                      glBindBuffer)
+        : preserve_binding(state_shadow::BIND_ARRAY_BUFFER)
     {
     }
 };
@@ -159,23 +500,19 @@ public:
 };
 
 
-class preserve_read_framebuffer : public preserve<GLuint> {
+class preserve_read_framebuffer : public preserve_binding {
 public:
     preserve_read_framebuffer()
-        : preserve(GL_READ_FRAMEBUFFER,
-                      GL_READ_FRAMEBUFFER_BINDING,
-                      glBindFramebuffer)
+        : preserve_binding(state_shadow::BIND_READ_FRAMEBUFFER)
     {
     }
 };
 
 
-class preserve_draw_framebuffer : public preserve<GLuint> {
+class preserve_draw_framebuffer : public preserve_binding {
 public:
     preserve_draw_framebuffer()
-        : preserve(GL_DRAW_FRAMEBUFFER,
-                      GL_DRAW_FRAMEBUFFER_BINDING,
-                      glBindFramebuffer)
+        : preserve_binding(state_shadow::BIND_DRAW_FRAMEBUFFER)
     {
     }
 };
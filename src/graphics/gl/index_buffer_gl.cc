@@ -0,0 +1,86 @@
+#include <index_buffer_gl.hh>
+#include <translate_constants_gl.hh>
+#include <buffer_map_gl.hh>
+
+namespace trillek {
+
+
+index_buffer_gl::index_buffer_gl(buffer_lifetime_t pLifetime,
+            index_type_t pType, uint32_t pIndexCount)
+    : index_buffer(pLifetime, pType, pIndexCount),
+      mLifetimeGL(translate_buffer_lifetime_gl(pLifetime)),
+      mIndexSize(index_type_size(pType)),
+      mOwnsHandle(true),
+      mPersistent(nullptr)
+{
+    gl::preserve_index_buffer idxbuf;
+
+    glGenBuffers(1, &mHandleGL);
+    gl::bind_buffer(GL_ELEMENT_ARRAY_BUFFER, mHandleGL);
+    mPersistent = gl::allocate_buffer(GL_ELEMENT_ARRAY_BUFFER,
+            pIndexCount * mIndexSize, pLifetime);
+    gl::check_gl_error("index_buffer_gl");
+}
+
+
+index_buffer_gl::index_buffer_gl(GLuint pHandle, index_type_t pType,
+            uint32_t pIndexCount)
+    : index_buffer(BUFFER_VOLATILE, pType, pIndexCount),
+      mHandleGL(pHandle),
+      mLifetimeGL(translate_buffer_lifetime_gl(BUFFER_VOLATILE)),
+      mIndexSize(index_type_size(pType)),
+      mOwnsHandle(false),
+      mPersistent(nullptr)
+{
+}
+
+
+index_buffer_gl::~index_buffer_gl() {
+    if (mOwnsHandle) {
+        gl::delete_buffer(mHandleGL);
+    }
+}
+
+
+void*
+index_buffer_gl::lock(uint32_t pIndexStart, uint32_t pIndexCount) {
+    if (!mOwnsHandle) {
+        throw std::logic_error("index_buffer_gl::lock");
+    }
+    if (mPersistent) {
+        return mPersistent + pIndexStart * mIndexSize;
+    }
+
+    gl::preserve_index_buffer idxbuf;
+
+    gl::bind_buffer(GL_ELEMENT_ARRAY_BUFFER, mHandleGL);
+    return gl::map_buffer_range(GL_ELEMENT_ARRAY_BUFFER, mLifetime,
+            pIndexStart * mIndexSize, pIndexCount * mIndexSize);
+}
+
+
+void
+index_buffer_gl::unlock() {
+    if (mPersistent) {
+        return;
+    }
+
+    gl::preserve_index_buffer idxbuf;
+
+    gl::bind_buffer(GL_ELEMENT_ARRAY_BUFFER, mHandleGL);
+    glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER);
+}
+
+
+void
+index_buffer_gl::select() {
+    gl::bind_buffer(GL_ELEMENT_ARRAY_BUFFER, mHandleGL);
+}
+
+
+void
+index_buffer_gl::deselect() {
+    gl::bind_buffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+}
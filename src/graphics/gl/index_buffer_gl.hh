@@ -0,0 +1,40 @@
+#ifndef INDEX_BUFFER_GL_HH_INCLUDED
+#define INDEX_BUFFER_GL_HH_INCLUDED
+
+#include <graphics_gl.hh>
+#include <primitive.hh>
+
+namespace trillek {
+
+struct index_buffer_gl : public index_buffer {
+    GLuint mHandleGL;
+    GLuint mLifetimeGL;
+    uint32_t mIndexSize;
+    bool mOwnsHandle;
+
+    // Where the buffer is persistently mapped, if it is.
+    uint8_t* mPersistent;
+
+    index_buffer_gl(buffer_lifetime_t pLifetime, index_type_t pType,
+                uint32_t pIndexCount);
+
+    // A view of pIndexCount indices in a buffer owned by someone else,
+    // such as the transient arena. It cannot be locked.
+    index_buffer_gl(GLuint pHandle, index_type_t pType,
+                uint32_t pIndexCount);
+
+    ~index_buffer_gl();
+
+    void* lock(uint32_t pIndexStart, uint32_t pIndexCount);
+
+    void unlock();
+
+    void select();
+
+    void deselect();
+
+};
+
+}
+
+#endif // INDEX_BUFFER_GL_HH_INCLUDED
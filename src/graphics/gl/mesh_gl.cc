@@ -6,19 +6,24 @@
 
 namespace trillek {
 
+// The index buffer binding belongs to the vertex array object, so the
+// vertex buffer has to be selected first.
 void
 mesh_gl::select()
 {
-//    mIndexBuffer->select();
     mVertexBuffer->select();
-    glUseProgram(0);
+    if (mIndexBuffer) {
+        mIndexBuffer->select();
+    }
 }
 
 
 void
 mesh_gl::deselect()
 {
-//    mIndexBuffer->deselect();
+    if (mIndexBuffer) {
+        mIndexBuffer->deselect();
+    }
     mVertexBuffer->deselect();
 }
 
@@ -27,8 +32,18 @@ void
 mesh_gl::draw()
 {
     gl::select_guard<mesh_gl> sel(*this);
-    std::shared_ptr<graphics_device>(mDevice)
-        ->draw_primitive(mType, mVertexStart, mVertexCount);
+    std::shared_ptr<graphics_device> device(mDevice);
+    if (mIndexBuffer) {
+        device->draw_indexed_primitive(mType, mIndexBuffer->index_type(),
+            mIndexStart, mPrimitiveCount);
+    }
+    else if (mRangeStarts.empty()) {
+        device->draw_primitive(mType, mVertexStart, mPrimitiveCount);
+    }
+    else {
+        device->draw_primitive_ranges(mType, mRangeStarts.data(),
+            mRangePrimitiveCounts.data(), mRangeStarts.size());
+    }
 }
 
 
@@ -39,12 +54,44 @@ mesh_gl::mesh_gl(const std::shared_ptr<graphics_device_gl>& pDevice,
     : mesh(pDevice)
 {
     mType = pType;
+    mPrimitiveCount = pPrimitiveCount;
     mVertexStart = 0;
     mVertexCount = translate_vertex_count_gl(pType, pPrimitiveCount);
-    // mIndexStart = 0;
-    // mIndexCount = translate_index_count_gl(pType, pPrimitiveCount);
-    // mMinIndex = 0;
-    // mIndexBuffer = pDevice->make_index_buffer(pLifetime, mIndexCount);
+    mVertexBuffer = pDevice->make_vertex_buffer(
+            std::static_pointer_cast<vertex_format>(pFormat),
+            mVertexCount, pLifetime);
+}
+
+
+mesh_gl::mesh_gl(const std::shared_ptr<graphics_device_gl>& pDevice,
+                buffer_lifetime_t pLifetime, primitive_type_t pType,
+                const std::shared_ptr<vertex_format_gl>& pFormat,
+                const std::vector<uint32_t>& pPrimitiveCounts)
+    : mesh(pDevice)
+{
+    mType = pType;
+    set_ranges(pPrimitiveCounts);
+    mVertexBuffer = pDevice->make_vertex_buffer(
+            std::static_pointer_cast<vertex_format>(pFormat),
+            mVertexCount, pLifetime);
+}
+
+
+mesh_gl::mesh_gl(const std::shared_ptr<graphics_device_gl>& pDevice,
+                buffer_lifetime_t pLifetime, primitive_type_t pType,
+                const std::shared_ptr<vertex_format_gl>& pFormat,
+                uint32_t pVertexCount, index_type_t pIndexType,
+                uint32_t pIndexCount)
+    : mesh(pDevice)
+{
+    mType = pType;
+    mPrimitiveCount = vertex_primitive_count(pType, pIndexCount);
+    mVertexStart = 0;
+    mVertexCount = pVertexCount;
+    mIndexStart = 0;
+    mIndexCount = pIndexCount;
+    mIndexBuffer = pDevice->make_index_buffer(pIndexType, mIndexCount,
+            pLifetime);
     mVertexBuffer = pDevice->make_vertex_buffer(
             std::static_pointer_cast<vertex_format>(pFormat),
             mVertexCount, pLifetime);
@@ -25,6 +25,17 @@ namespace trillek {
                 const std::shared_ptr<vertex_format_gl>& pFormat,
                 uint32_t pPrimitiveCount);
 
+        mesh_gl(const std::shared_ptr<graphics_device_gl>& pDevice,
+                buffer_lifetime_t pLifetime, primitive_type_t pType,
+                const std::shared_ptr<vertex_format_gl>& pFormat,
+                const std::vector<uint32_t>& pPrimitiveCounts);
+
+        mesh_gl(const std::shared_ptr<graphics_device_gl>& pDevice,
+                buffer_lifetime_t pLifetime, primitive_type_t pType,
+                const std::shared_ptr<vertex_format_gl>& pFormat,
+                uint32_t pVertexCount, index_type_t pIndexType,
+                uint32_t pIndexCount);
+
         ~mesh_gl();
     };
 
@@ -0,0 +1,210 @@
+#include <program_cache_gl.hh>
+#include <extensions_gl.hh>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <vector>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+namespace trillek { namespace gl {
+
+namespace {
+
+    // Each file holds this header, the full key (to rule out hash
+    // collisions) and then the binary.
+    struct cache_header_t {
+        char mMagic[4];
+        uint32_t mFormat;
+        uint32_t mKeyBytes;
+        uint32_t mBinaryBytes;
+    };
+
+    const char sMagic[4] = { 'T', 'P', 'B', '1' };
+
+    std::string
+    default_program_cache_directory() {
+        if (const char* dir = std::getenv("TRILLEK_SHADER_CACHE")) {
+            return dir;
+        }
+#ifdef _WIN32
+        const char* base = std::getenv("LOCALAPPDATA");
+        return base ? std::string(base) + "/trillek-shaders" : "";
+#else
+        if (const char* base = std::getenv("XDG_CACHE_HOME")) {
+            return std::string(base) + "/trillek-shaders";
+        }
+        const char* home = std::getenv("HOME");
+        return home ? std::string(home) + "/.cache/trillek-shaders" : "";
+#endif
+    }
+
+    // FNV-1a, which is plenty to name the files; the key itself is
+    // compared on load.
+    uint64_t
+    hash_key(const std::string& pKey) {
+        uint64_t hash = 14695981039346656037ull;
+        for (unsigned char c : pKey) {
+            hash = (hash ^ c) * 1099511628211ull;
+        }
+        return hash;
+    }
+
+    std::string
+    cache_path(const std::string& pKey) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "/%016llx.bin",
+            (unsigned long long)hash_key(pKey));
+        return sProgramCacheDirectory + name;
+    }
+
+    const char*
+    gl_string(GLenum pName) {
+        const char* s = (const char*)glGetString(pName);
+        return s ? s : "";
+    }
+
+    // Make pPath and any of its parents which don't exist yet. Failures
+    // show up when the file is written.
+    void
+    make_directories(const std::string& pPath) {
+        for (size_t at = 1; at <= pPath.size(); ++at) {
+            if (at < pPath.size() && pPath[at] != '/' && pPath[at] != '\\') {
+                continue;
+            }
+            std::string dir = pPath.substr(0, at);
+#ifdef _WIN32
+            _mkdir(dir.c_str());
+#else
+            mkdir(dir.c_str(), 0755);
+#endif
+        }
+    }
+
+    bool
+    accepts_format(GLenum pFormat) {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &count);
+        std::vector<GLint> formats(std::max(count, 1));
+        glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, formats.data());
+        return std::find(formats.begin(), formats.begin() + count,
+            (GLint)pFormat) != formats.begin() + count;
+    }
+
+}
+
+
+std::string sProgramCacheDirectory = default_program_cache_directory();
+
+
+bool
+has_program_binary() {
+    if (!version_at_least(4, 1)
+            && !has_extension("GL_ARB_get_program_binary")) {
+        return false;
+    }
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &count);
+    return count > 0;
+}
+
+
+std::string
+program_cache_key(const std::string& pSources) {
+    std::string key;
+    key += gl_string(GL_VENDOR);
+    key += '\n';
+    key += gl_string(GL_RENDERER);
+    key += '\n';
+    key += gl_string(GL_VERSION);
+    key += '\n';
+    key += pSources;
+    return key;
+}
+
+
+bool
+load_program_binary(GLuint pProgram, const std::string& pKey) {
+    std::ifstream in(cache_path(pKey).c_str(), std::ios::binary);
+    in.seekg(0, std::ios::end);
+    uint64_t length = in ? (uint64_t)in.tellg() : 0;
+    in.seekg(0, std::ios::beg);
+
+    // The sizes are checked against the file before anything is
+    // allocated, so that a damaged file is just a miss.
+    cache_header_t header;
+    if (!in.read((char*)&header, sizeof(header))
+            || std::memcmp(header.mMagic, sMagic, sizeof(sMagic)) != 0
+            || header.mKeyBytes != pKey.size()
+            || sizeof(header) + (uint64_t)header.mKeyBytes
+                + header.mBinaryBytes != length) {
+        return false;
+    }
+
+    std::string key(header.mKeyBytes, '\0');
+    std::vector<char> binary(header.mBinaryBytes);
+    if (!in.read(&key[0], key.size()) || key != pKey
+            || !in.read(binary.data(), binary.size())) {
+        return false;
+    }
+
+    // An unknown format would be a GL error rather than a failed link.
+    if (!accepts_format(header.mFormat)) {
+        return false;
+    }
+    glProgramBinary(pProgram, header.mFormat, binary.data(), binary.size());
+
+    GLint status = 0;
+    glGetProgramiv(pProgram, GL_LINK_STATUS, &status);
+    return status != 0;
+}
+
+
+void
+save_program_binary(GLuint pProgram, const std::string& pKey) {
+    GLint length = 0;
+    glGetProgramiv(pProgram, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+
+    cache_header_t header;
+    std::memcpy(header.mMagic, sMagic, sizeof(sMagic));
+    std::vector<char> binary(length);
+    GLenum format;
+    glGetProgramBinary(pProgram, length, &length, &format, binary.data());
+    header.mFormat = format;
+    header.mKeyBytes = pKey.size();
+    header.mBinaryBytes = length;
+
+    make_directories(sProgramCacheDirectory);
+
+    // Write to one side and move into place, so that another run never
+    // sees half a file.
+    std::string path = cache_path(pKey);
+    std::string temp = path + ".tmp";
+    {
+        std::ofstream out(temp.c_str(), std::ios::binary | std::ios::trunc);
+        out.write((const char*)&header, sizeof(header));
+        out.write(pKey.data(), pKey.size());
+        out.write(binary.data(), length);
+        if (!out) {
+            out.close();
+            std::remove(temp.c_str());
+            return;
+        }
+    }
+#ifdef _WIN32
+    std::remove(path.c_str());
+#endif
+    if (std::rename(temp.c_str(), path.c_str()) != 0) {
+        std::remove(temp.c_str());
+    }
+}
+
+
+} }
@@ -0,0 +1,41 @@
+#ifndef PROGRAM_CACHE_GL_HH_INCLUDED
+#define PROGRAM_CACHE_GL_HH_INCLUDED
+
+#include <graphics_gl.hh>
+#include <string>
+
+namespace trillek { namespace gl {
+
+
+// Where linked program binaries are kept between runs, or empty for no
+// cache. Defaults to $TRILLEK_SHADER_CACHE, or else a trillek-shaders
+// directory in the user's cache directory.
+extern std::string sProgramCacheDirectory;
+
+
+// True if the current context can hand out and take back program
+// binaries (ARB_get_program_binary, core since GL 4.1).
+bool has_program_binary();
+
+
+// The cache key for a program linked from pSources, which should hold
+// every stage's type and text with its defines applied. A binary is only
+// good for the driver that made it, so the key includes the context's
+// vendor, renderer and version strings.
+std::string program_cache_key(const std::string& pSources);
+
+
+// Load the binary saved under pKey into pProgram. False, leaving
+// pProgram to be linked from source, if there isn't one or the driver
+// no longer accepts it.
+bool load_program_binary(GLuint pProgram, const std::string& pKey);
+
+
+// Save the linked pProgram's binary under pKey. The cache is only an
+// optimisation, so failures are ignored.
+void save_program_binary(GLuint pProgram, const std::string& pKey);
+
+
+} }
+
+#endif // PROGRAM_CACHE_GL_HH_INCLUDED
@@ -0,0 +1,228 @@
+#include <shader_program_gl.hh>
+#include <program_cache_gl.hh>
+
+namespace trillek {
+
+namespace {
+
+    const char*
+    sVertShader =
+        "#version 330 core\n"
+
+        "layout(std140) uniform per_draw {\n"
+        "    mat4 modelview;\n"
+        "    mat4 mvptransform;\n"
+        "    mat4 ntransform;\n"
+        "    vec4 tint;\n"
+        "};\n"
+
+        "in vec4 position;\n"
+        "in vec4 color;\n"
+
+        "#ifdef INSTANCED\n"
+        "in mat4 instanceTransform;\n"
+        "in vec4 instanceTint;\n"
+        "#endif\n"
+
+        "out vec4 colorVarying;\n"
+
+        "void main()\n"
+        "{\n"
+        "#ifdef INSTANCED\n"
+        "    colorVarying = color * tint * instanceTint;\n"
+        "    gl_Position = mvptransform * (instanceTransform * position);\n"
+        "#else\n"
+        "    colorVarying = color * tint;\n"
+        "    gl_Position = mvptransform * position;\n"
+        "#endif\n"
+        "}\n";
+
+    const char*
+    sFragShader =
+        "#version 330 core\n"
+
+        "in vec4 colorVarying;\n"
+
+        "out vec4 fragColor;\n"
+
+        "void main()\n"
+        "{\n"
+        "    fragColor = colorVarying;\n"
+        "}\n";
+
+    const char* const
+    sAttributeNames[ATTRIB_LAST] = {
+        "position",
+        "normal",
+        "color",
+        "texcoord0",
+        "texcoord1",
+        "texcoord2",
+        "texcoord3",
+        "instanceTransform",
+        nullptr,
+        nullptr,
+        nullptr,
+        "instanceTint"
+    };
+
+    const char* const
+    sBlockNames[BLOCK_LAST] = {
+        "per_draw"
+    };
+
+}
+
+
+shader_gl::shader_gl(GLenum pType, const char* pText)
+{
+    mHandleGL = glCreateShader(pType);
+    glShaderSource(mHandleGL, 1, (const GLchar**)&pText, 0);
+    glCompileShader(mHandleGL);
+
+    GLint status;
+    glGetShaderiv(mHandleGL, GL_COMPILE_STATUS, &status);
+    if (status == 0) {
+        GLint logLength = 0;
+        glGetShaderiv(mHandleGL, GL_INFO_LOG_LENGTH, &logLength);
+        std::string log(std::max(logLength, 1), '\0');
+        glGetShaderInfoLog(mHandleGL, log.size(), nullptr, &log[0]);
+        glDeleteShader(mHandleGL);
+        throw std::invalid_argument("shader_gl: " + std::string(log.c_str()));
+    }
+}
+
+
+shader_gl::~shader_gl()
+{
+    glDeleteShader(mHandleGL);
+}
+
+
+shader_program_gl::shader_program_gl()
+{
+    mHandleGL = glCreateProgram();
+    gl::check_gl_error("shader_program_gl");
+    mSources.reserve(2);
+}
+
+
+shader_program_gl::~shader_program_gl()
+{
+    gl::forget(gl::state_shadow::BIND_PROGRAM, mHandleGL);
+    glDeleteProgram(mHandleGL);
+}
+
+
+void
+shader_program_gl::define(const std::string& pName,
+        const std::string& pValue)
+{
+    mDefines += "#define " + pName + " " + pValue + "\n";
+}
+
+
+void
+shader_program_gl::add_source(GLenum pType, const std::string& pText)
+{
+    // The #version line has to come first.
+    size_t at = 0;
+    if (pText.compare(0, 8, "#version") == 0) {
+        at = pText.find('\n');
+        at = at == std::string::npos ? pText.size() : at + 1;
+    }
+    std::string text = pText;
+    text.insert(at, mDefines);
+    mSources.push_back(std::make_pair(pType, std::move(text)));
+}
+
+
+void
+shader_program_gl::link()
+{
+    std::string key;
+    if (!gl::sProgramCacheDirectory.empty() && gl::has_program_binary()) {
+        for (auto& source : mSources) {
+            key += std::to_string(source.first) + "\n" + source.second;
+        }
+        key = gl::program_cache_key(key);
+        if (gl::load_program_binary(mHandleGL, key)) {
+            bind_blocks();
+            return;
+        }
+        glProgramParameteri(mHandleGL, GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+            GL_TRUE);
+    }
+
+    std::vector<std::unique_ptr<shader_gl>> shaders;
+    for (auto& source : mSources) {
+        shaders.emplace_back(
+            new shader_gl(source.first, source.second.c_str()));
+        glAttachShader(mHandleGL, shaders.back()->handle());
+    }
+    for (unsigned i = 0; i < ATTRIB_LAST; ++i) {
+        if (sAttributeNames[i]) {
+            glBindAttribLocation(mHandleGL, i, sAttributeNames[i]);
+        }
+    }
+    glLinkProgram(mHandleGL);
+    for (auto& shader : shaders) {
+        glDetachShader(mHandleGL, shader->handle());
+    }
+
+    GLint status;
+    glGetProgramiv(mHandleGL, GL_LINK_STATUS, &status);
+    if (status == 0) {
+        GLint logLength = 0;
+        glGetProgramiv(mHandleGL, GL_INFO_LOG_LENGTH, &logLength);
+        std::string log(std::max(logLength, 1), '\0');
+        glGetProgramInfoLog(mHandleGL, log.size(), nullptr, &log[0]);
+        throw std::invalid_argument("shader_program_gl::link: "
+            + std::string(log.c_str()));
+    }
+
+    bind_blocks();
+    if (!key.empty()) {
+        gl::save_program_binary(mHandleGL, key);
+    }
+}
+
+
+// Block bindings aren't part of a program binary, so this is needed
+// however the program was linked.
+void
+shader_program_gl::bind_blocks()
+{
+    // Programs may leave out blocks they don't use.
+    for (unsigned i = 0; i < BLOCK_LAST; ++i) {
+        GLuint index = glGetUniformBlockIndex(mHandleGL, sBlockNames[i]);
+        if (index != GL_INVALID_INDEX) {
+            glUniformBlockBinding(mHandleGL, index, i);
+        }
+    }
+    gl::check_gl_error("shader_program_gl::link");
+}
+
+
+void
+shader_program_gl::select()
+{
+    gl::use_program(mHandleGL);
+}
+
+
+std::unique_ptr<shader_program_gl>
+make_standard_program_gl(bool pInstanced)
+{
+    std::unique_ptr<shader_program_gl> program(new shader_program_gl);
+    if (pInstanced) {
+        program->define("INSTANCED");
+    }
+    program->add_source(GL_VERTEX_SHADER, sVertShader);
+    program->add_source(GL_FRAGMENT_SHADER, sFragShader);
+    program->link();
+    return program;
+}
+
+
+}
@@ -0,0 +1,98 @@
+#ifndef SHADER_PROGRAM_GL_HH_INCLUDED
+#define SHADER_PROGRAM_GL_HH_INCLUDED
+
+#include <graphics_gl.hh>
+#include <transform.hh>
+#include <string>
+
+namespace trillek {
+
+    // Generic vertex attribute locations, the same in every program.
+    enum vertex_attribute_gl_t {
+        ATTRIB_POSITION = 0,
+        ATTRIB_NORMAL,
+        ATTRIB_COLOR,
+        ATTRIB_TEXCOORD0,
+        ATTRIB_TEXCOORD_LAST = ATTRIB_TEXCOORD0 + 4,
+
+        // Per-instance attributes, read by instanced programs. The
+        // transform is a mat4, which takes a location per column.
+        ATTRIB_INSTANCE_TRANSFORM = ATTRIB_TEXCOORD_LAST,
+        ATTRIB_INSTANCE_TINT = ATTRIB_INSTANCE_TRANSFORM + 4,
+        ATTRIB_LAST
+    };
+
+    // Uniform buffer binding points, the same in every program.
+    enum uniform_block_gl_t {
+        BLOCK_DRAW = 0,
+        BLOCK_LAST
+    };
+
+    // The "per_draw" uniform block, in its std140 layout: the transforms
+    // and constants for one draw. The normal transform is a mat3 padded
+    // out to a mat4, and the tint multiplies the vertex colour.
+    struct draw_block_gl {
+        matrix4_t mModelView;
+        matrix4_t mModelViewProjection;
+        matrix4_t mNormal;
+        float_t mTint[4];
+    };
+
+    class shader_gl : private boost::noncopyable {
+    public:
+        shader_gl(GLenum pType, const char* pText);
+
+        ~shader_gl();
+
+        GLuint handle() const {
+            return mHandleGL;
+        }
+
+    private:
+        GLuint mHandleGL;
+    };
+
+    class shader_program_gl : private boost::noncopyable {
+    public:
+        shader_program_gl();
+
+        ~shader_program_gl();
+
+        // Adds "#define pName pValue" to every stage, after its #version
+        // line. Only sources added afterwards are affected.
+        void define(const std::string& pName,
+                const std::string& pValue = "1");
+
+        void add_source(GLenum pType, const std::string& pText);
+
+        // Compiles the sources, binds the standard attribute locations and
+        // uniform blocks, and links. If the program cache holds a binary
+        // of the same sources from the same driver, that is loaded instead
+        // of compiling anything. Throws, with the GL's log, if compiling
+        // or linking fails.
+        void link();
+
+        void select();
+
+        GLuint handle() const {
+            return mHandleGL;
+        }
+
+    private:
+        GLuint mHandleGL;
+        std::string mDefines;
+        std::vector<std::pair<GLenum, std::string>> mSources;
+
+        void bind_blocks();
+    };
+
+    // The program graphics_device_gl draws with: the vertex colour,
+    // tinted and transformed by the per_draw block. The instanced variant
+    // applies each instance's transform and tint before the block's.
+    std::unique_ptr<shader_program_gl>
+    make_standard_program_gl(bool pInstanced = false);
+
+}
+
+
+#endif // SHADER_PROGRAM_GL_HH_INCLUDED
@@ -102,13 +102,13 @@ struct texture_target_gl_fbo : public texture_target_gl::impl {
 
     ~texture_target_gl_fbo()
     {
-        glDeleteFramebuffers(1, &mFramebuffer);
+        gl::delete_framebuffer(mFramebuffer);
     }
 
     void
     apply_state(texture_target_gl& pTarget)
     {
-        glBindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
+        gl::bind_framebuffer(GL_FRAMEBUFFER, mFramebuffer);
    
         auto color0 = pTarget.get_slot(texture_target::COLOR0);
         if (color0)
@@ -149,21 +149,21 @@ struct texture_target_gl_fbo : public texture_target_gl::impl {
             glFramebufferTexture2D(GL_FRAMEBUFFER,
                 GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, 0, 0);
         }
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        gl::bind_framebuffer(GL_FRAMEBUFFER, 0);
     }
 
     void
     select(texture_target_gl& pTarget)
     {
-        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, mFramebuffer);
-        glBindFramebuffer(GL_READ_FRAMEBUFFER, mFramebuffer);
+        gl::bind_framebuffer(GL_DRAW_FRAMEBUFFER, mFramebuffer);
+        gl::bind_framebuffer(GL_READ_FRAMEBUFFER, mFramebuffer);
     }
 
     void
     deselect(texture_target_gl& pTarget)
     {
-        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
-        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+        gl::bind_framebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        gl::bind_framebuffer(GL_READ_FRAMEBUFFER, 0);
 
         auto color0 = pTarget.get_slot(texture_target::COLOR0);
         if (!color0) {
@@ -0,0 +1,116 @@
+#include <transient_arena_gl.hh>
+#include <vertex_buffer_gl.hh>
+#include <index_buffer_gl.hh>
+#include <buffer_map_gl.hh>
+
+namespace trillek {
+
+
+transient_arena_gl::transient_arena_gl(uint32_t pRegionBytes,
+            uint32_t pRegions)
+    : transient_arena(pRegionBytes, pRegions),
+      mPersistent(nullptr), mFences(pRegions, nullptr)
+{
+    gl::preserve_vertex_buffer vtxbuf;
+
+    glGenBuffers(1, &mHandleGL);
+    gl::bind_buffer(GL_ARRAY_BUFFER, mHandleGL);
+    mPersistent = gl::allocate_buffer(GL_ARRAY_BUFFER,
+            pRegionBytes * pRegions, BUFFER_DYNAMIC);
+    gl::check_gl_error("transient_arena_gl");
+}
+
+
+transient_arena_gl::~transient_arena_gl() {
+    unmap();
+    for (auto fence : mFences) {
+        if (fence) {
+            glDeleteSync(fence);
+        }
+    }
+    gl::delete_buffer(mHandleGL);
+}
+
+
+void
+transient_arena_gl::wait_region(uint32_t pRegion) {
+    GLsync fence = mFences[pRegion];
+    if (!fence) {
+        return;
+    }
+
+    // Flush on the first wait, in case the fence is still sitting in an
+    // unsubmitted command buffer.
+    GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+    for (;;) {
+        GLenum result = glClientWaitSync(fence, flags, 1000000000);
+        if (result == GL_ALREADY_SIGNALED
+                || result == GL_CONDITION_SATISFIED) {
+            break;
+        }
+        if (result == GL_WAIT_FAILED) {
+            gl::check_gl_error("transient_arena_gl::wait_region");
+            throw std::runtime_error("transient_arena_gl::wait_region");
+        }
+        flags = 0;
+    }
+    glDeleteSync(fence);
+    mFences[pRegion] = nullptr;
+}
+
+
+void
+transient_arena_gl::fence_region(uint32_t pRegion) {
+    if (mFences[pRegion]) {
+        glDeleteSync(mFences[pRegion]);
+    }
+    mFences[pRegion] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+
+// The fences guarantee that the GPU is done with the region, so the range
+// can be mapped without the driver synchronising or keeping its contents.
+uint8_t*
+transient_arena_gl::map_range(uint32_t pOffset, uint32_t pBytes) {
+    if (mPersistent) {
+        return mPersistent + pOffset;
+    }
+
+    gl::preserve_vertex_buffer vtxbuf;
+
+    gl::bind_buffer(GL_ARRAY_BUFFER, mHandleGL);
+    return static_cast<uint8_t*>(gl::map_buffer_range(GL_ARRAY_BUFFER,
+            BUFFER_DYNAMIC, pOffset, pBytes));
+}
+
+
+void
+transient_arena_gl::unmap_range() {
+    if (mPersistent) {
+        return;
+    }
+
+    gl::preserve_vertex_buffer vtxbuf;
+
+    gl::bind_buffer(GL_ARRAY_BUFFER, mHandleGL);
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+}
+
+
+std::shared_ptr<vertex_buffer>
+transient_arena_gl::make_vertex_view(std::shared_ptr<vertex_format> pFormat)
+{
+    uint32_t count = mRegionBytes * mRegions / pFormat->size();
+    return std::make_shared<vertex_buffer_gl>(mHandleGL, std::move(pFormat),
+        count);
+}
+
+
+std::shared_ptr<index_buffer>
+transient_arena_gl::make_index_view(index_type_t pType)
+{
+    uint32_t count = mRegionBytes * mRegions / index_type_size(pType);
+    return std::make_shared<index_buffer_gl>(mHandleGL, pType, count);
+}
+
+}
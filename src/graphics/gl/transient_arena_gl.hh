@@ -0,0 +1,46 @@
+#ifndef TRANSIENT_ARENA_GL_HH_INCLUDED
+#define TRANSIENT_ARENA_GL_HH_INCLUDED
+
+#include <graphics_gl.hh>
+#include <transient_arena.hh>
+
+namespace trillek {
+
+class transient_arena_gl : public transient_arena {
+public:
+    transient_arena_gl(uint32_t pRegionBytes, uint32_t pRegions);
+
+    ~transient_arena_gl();
+
+    GLuint handle() const {
+        return mHandleGL;
+    }
+
+    // True if the buffer stays mapped, so that allocate() costs nothing.
+    bool persistent() const {
+        return mPersistent != nullptr;
+    }
+
+protected:
+    void wait_region(uint32_t pRegion);
+
+    void fence_region(uint32_t pRegion);
+
+    uint8_t* map_range(uint32_t pOffset, uint32_t pBytes);
+
+    void unmap_range();
+
+    std::shared_ptr<vertex_buffer>
+    make_vertex_view(std::shared_ptr<vertex_format> pFormat);
+
+    std::shared_ptr<index_buffer> make_index_view(index_type_t pType);
+
+private:
+    GLuint mHandleGL;
+    uint8_t* mPersistent;
+    std::vector<GLsync> mFences;
+};
+
+}
+
+#endif // TRANSIENT_ARENA_GL_HH_INCLUDED
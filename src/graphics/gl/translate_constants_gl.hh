@@ -31,15 +31,8 @@ translate_primitive_type_gl(primitive_type_t pType) {
     case PRIM_TRIANGLE_FAN:
         return GL_TRIANGLE_FAN;
 
-    case PRIM_POLYGON:
-        return GL_POLYGON;
-
-    case PRIM_QUADS:
-        return GL_QUADS;
-
-    case PRIM_QUAD_STRIP:
-        return GL_QUAD_STRIP;
-
+    // Polygons and quads aren't in the core profile, and the device
+    // doesn't make meshes of them.
     default:
         throw std::logic_error("translate_primitive_type_gl");
     }
@@ -141,6 +134,21 @@ translate_buffer_lifetime_gl(buffer_lifetime_t pLifetime) {
 }
 
 
+inline GLenum
+translate_index_type_gl(index_type_t pType) {
+    switch (pType) {
+    case INDEX_16:
+        return GL_UNSIGNED_SHORT;
+
+    case INDEX_32:
+        return GL_UNSIGNED_INT;
+
+    default:
+        throw std::logic_error("translate_index_type_gl");
+    }
+}
+
+
 inline GLuint
 translate_vertdata_bytesize_gl(vertdata_type_t pType) {
     switch (pType) {
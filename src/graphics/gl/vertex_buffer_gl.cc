@@ -1,6 +1,8 @@
 #include <vertex_buffer_gl.hh>
 #include <translate_constants_gl.hh>
-#include <translate_constants_gl.hh>
+#include <buffer_map_gl.hh>
+#include <vertex_format_gl.hh>
+#include <shader_program_gl.hh>
 
 namespace trillek {
 
@@ -9,52 +11,113 @@ vertex_buffer_gl::vertex_buffer_gl(buffer_lifetime_t pLifetime,
             std::shared_ptr<vertex_format> pFormat,
             uint32_t pVertexCount)
     : vertex_buffer(pLifetime, std::move(pFormat), pVertexCount),
-      mLifetimeGL(translate_buffer_lifetime_gl(pLifetime))
+      mLifetimeGL(translate_buffer_lifetime_gl(pLifetime)),
+      mOwnsHandle(true),
+      mPersistent(nullptr),
+      mVertexArrayGL(0),
+      mVertexArrayGeneration(0)
 {
     gl::preserve_vertex_buffer vtxbuf;
 
     mVertexSize = mFormat->size();
     glGenBuffers(1, &mHandleGL);
-    glBindBuffer(GL_ARRAY_BUFFER, mHandleGL);
-    glBufferData(GL_ARRAY_BUFFER, pVertexCount * mVertexSize, NULL,
-            mLifetimeGL);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    gl::check_gl_error();
+    gl::bind_buffer(GL_ARRAY_BUFFER, mHandleGL);
+    mPersistent = gl::allocate_buffer(GL_ARRAY_BUFFER,
+            pVertexCount * mVertexSize, pLifetime);
+    gl::check_gl_error("vertex_buffer_gl");
+}
+
+
+vertex_buffer_gl::vertex_buffer_gl(GLuint pHandle,
+            std::shared_ptr<vertex_format> pFormat,
+            uint32_t pVertexCount)
+    : vertex_buffer(BUFFER_VOLATILE, std::move(pFormat), pVertexCount),
+      mHandleGL(pHandle),
+      mLifetimeGL(translate_buffer_lifetime_gl(BUFFER_VOLATILE)),
+      mOwnsHandle(false),
+      mPersistent(nullptr),
+      mVertexArrayGL(0),
+      mVertexArrayGeneration(0)
+{
+    mVertexSize = mFormat->size();
 }
 
 
 vertex_buffer_gl::~vertex_buffer_gl() {
-    glDeleteBuffers(1, &mHandleGL);
+    if (mVertexArrayGL) {
+        gl::delete_vertex_array(mVertexArrayGL);
+    }
+    if (mOwnsHandle) {
+        gl::delete_buffer(mHandleGL);
+    }
 }
 
 
 void*
 vertex_buffer_gl::lock(uint32_t pVertexStart, uint32_t pVertexCount) {
+    if (!mOwnsHandle) {
+        throw std::logic_error("vertex_buffer_gl::lock");
+    }
+    if (mPersistent) {
+        return mPersistent + pVertexStart * mVertexSize;
+    }
+
     gl::preserve_vertex_buffer vtxbuf;
 
-    glBindBuffer(GL_ARRAY_BUFFER, mHandleGL);
-    gl::check_gl_error();
-    uint8_t* buffer = (uint8_t*)glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
-    gl::check_gl_error();
-    return (void*)(buffer + pVertexStart * mVertexSize);
+    gl::bind_buffer(GL_ARRAY_BUFFER, mHandleGL);
+    return gl::map_buffer_range(GL_ARRAY_BUFFER, mLifetime,
+            pVertexStart * mVertexSize, pVertexCount * mVertexSize);
 }
 
 
 
 void
 vertex_buffer_gl::unlock() {
+    if (mPersistent) {
+        return;
+    }
+
     gl::preserve_vertex_buffer vtxbuf;
 
-    glBindBuffer(GL_ARRAY_BUFFER, mHandleGL);
+    gl::bind_buffer(GL_ARRAY_BUFFER, mHandleGL);
     glUnmapBuffer(GL_ARRAY_BUFFER);
 }
 
 
 void
 vertex_buffer_gl::select() {
-    glBindBuffer(GL_ARRAY_BUFFER, mHandleGL);
+    const vertex_format_gl& format
+        = static_cast<const vertex_format_gl&>(*mFormat);
+    if (!mVertexArrayGL || mVertexArrayGeneration != format.mGeneration) {
+        build_vertex_array();
+    }
+    else {
+        gl::bind_vertex_array(mVertexArrayGL);
+    }
+}
+
+
+void
+vertex_buffer_gl::deselect() {
+    gl::bind_vertex_array(0);
+}
+
+
+// Record the attribute arrays into a fresh vertex array object, which is
+// left bound. A stale one is thrown away rather than patched, as it may
+// have arrays enabled which the new layout doesn't use.
+void
+vertex_buffer_gl::build_vertex_array() {
+    if (mVertexArrayGL) {
+        gl::delete_vertex_array(mVertexArrayGL);
+    }
+    glGenVertexArrays(1, &mVertexArrayGL);
+    gl::bind_vertex_array(mVertexArrayGL);
+    gl::bind_buffer(GL_ARRAY_BUFFER, mHandleGL);
 
-    vertex_format& format = *mFormat;
+    const vertex_format_gl& format
+        = static_cast<const vertex_format_gl&>(*mFormat);
+    mVertexArrayGeneration = format.mGeneration;
     uint32_t vertsize = format.size();
     uint32_t nelements = format.elements();
     uint32_t texture = 0;
@@ -63,71 +126,41 @@ vertex_buffer_gl::select() {
     for (unsigned i = 0; i < nelements; ++i) {
         const vertex_element_t& element = format[i];
         GLuint elsize = translate_vertdata_type_gl(element.mType);
+        GLuint attribute;
         switch (element.mMeaning) {
         case VERTDATA_POSITION:
-            glEnableClientState(GL_VERTEX_ARRAY);
-            glVertexPointer(elsize, GL_FLOAT, vertsize, bufferStart);
+            attribute = ATTRIB_POSITION;
             break;
 
         case VERTDATA_NORMAL:
-            glEnableClientState(GL_NORMAL_ARRAY);
-            glNormalPointer(GL_FLOAT, vertsize, bufferStart);
+            attribute = ATTRIB_NORMAL;
             break;
 
         case VERTDATA_COLOR:
-            glEnableClientState(GL_COLOR_ARRAY);
-            glColorPointer(elsize, GL_UNSIGNED_BYTE, vertsize, bufferStart);
+            attribute = ATTRIB_COLOR;
             break;
 
         case VERTDATA_TEXCOORD:
-            glClientActiveTexture(GL_TEXTURE0 + texture);
-            glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-            glTexCoordPointer(elsize, GL_FLOAT, vertsize, bufferStart);
-            ++texture;
+            if (ATTRIB_TEXCOORD0 + texture >= ATTRIB_TEXCOORD_LAST) {
+                throw std::logic_error(
+                    "vertex_buffer_gl::build_vertex_array");
+            }
+            attribute = ATTRIB_TEXCOORD0 + texture++;
             break;
 
         default:
-            throw std::logic_error("vertex_buffer_gl::select");
+            throw std::logic_error("vertex_buffer_gl::build_vertex_array");
         }
-        bufferStart += translate_vertdata_bytesize_gl(element.mType);
-    }
-    gl::check_gl_error();
-}
-
-void
-vertex_buffer_gl::deselect() {
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-    vertex_format& format = *mFormat;
-    uint32_t nelements = format.elements();
-    uint32_t texture = 0;
-
-    for (unsigned i = 0; i < nelements; ++i) {
-        switch (format[i].mMeaning) {
-        case VERTDATA_POSITION:
-            glDisableClientState(GL_VERTEX_ARRAY);
-            break;
 
-        case VERTDATA_NORMAL:
-            glDisableClientState(GL_NORMAL_ARRAY);
-            break;
-
-        case VERTDATA_COLOR:
-            glDisableClientState(GL_COLOR_ARRAY);
-            break;
-
-        case VERTDATA_TEXCOORD:
-            glClientActiveTexture(GL_TEXTURE0 + texture);
-            glDisableClientState(GL_TEXTURE_COORD_ARRAY);
-            ++texture;
-            break;
-
-        default:
-            throw std::logic_error("vertex_buffer_gl::deselect");
-        }
+        // Byte colours are normalised to [0, 1], as glColorPointer did.
+        bool bytes = element.mType == VERTDATA_TYPE_BYTE4;
+        glEnableVertexAttribArray(attribute);
+        glVertexAttribPointer(attribute, elsize,
+            bytes ? GL_UNSIGNED_BYTE : GL_FLOAT, bytes ? GL_TRUE : GL_FALSE,
+            vertsize, bufferStart);
+        bufferStart += translate_vertdata_bytesize_gl(element.mType);
     }
-    gl::check_gl_error();
+    gl::check_gl_error("vertex_buffer_gl::build_vertex_array");
 }
 
 }
-
@@ -10,11 +10,25 @@ struct vertex_buffer_gl : public vertex_buffer {
     GLuint mHandleGL;
     GLuint mLifetimeGL;
     uint32_t mVertexSize;
+    bool mOwnsHandle;
+
+    // Where the buffer is persistently mapped, if it is.
+    uint8_t* mPersistent;
+
+    // The vertex array object which binds this buffer with its format,
+    // built on first select, and the format generation it was built for.
+    GLuint mVertexArrayGL;
+    uint32_t mVertexArrayGeneration;
 
     vertex_buffer_gl(buffer_lifetime_t pLifetime,
                 std::shared_ptr<vertex_format> pFormat,
                 uint32_t pVertexCount);
 
+    // A view of pVertexCount vertices in a buffer owned by someone else,
+    // such as the transient arena. It cannot be locked.
+    vertex_buffer_gl(GLuint pHandle, std::shared_ptr<vertex_format> pFormat,
+                uint32_t pVertexCount);
+
     ~vertex_buffer_gl();
 
     void* lock(uint32_t pVertexStart, uint32_t pVertexCount);
@@ -25,6 +39,8 @@ struct vertex_buffer_gl : public vertex_buffer {
 
     void deselect();
 
+private:
+    void build_vertex_array();
 };
 
 }
@@ -6,12 +6,17 @@
 namespace trillek {
 
 struct vertex_format_gl : public vertex_format {
+    // Bumped whenever the layout changes, so that vertex array objects
+    // built for an older layout can tell they are stale.
+    uint32_t mGeneration;
+
     vertex_format_gl(std::string pDescription)
-        : vertex_format(pDescription)
+        : vertex_format(pDescription), mGeneration(0)
     {
     }
 
     void update_device() {
+        ++mGeneration;
     }
 };
 
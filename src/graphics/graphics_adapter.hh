@@ -2,6 +2,7 @@
 #define GRAPHICS_ADAPTER_HH_INCLUDED
 
 #include <graphics_device.hh>
+#include <functional>
 
 namespace trillek {
 
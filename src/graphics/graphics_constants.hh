@@ -35,6 +35,12 @@ namespace trillek {
         BUFFER_LAST
     };
 
+    enum index_type_t {
+        INDEX_16 = 0,
+        INDEX_32,
+        INDEX_LAST
+    };
+
     enum primitive_type_t {
         PRIM_POINTS,
         PRIM_LINES,
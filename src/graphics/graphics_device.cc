@@ -2,14 +2,32 @@
 #include <primitive.hh>
 #include <draw_immediate.hh>
 #include <graphics_state.hh>
+#include <transient_arena.hh>
 
 namespace trillek {
 
+namespace {
+    const uint32_t DEFAULT_TRANSIENT_BYTES_PER_FRAME = 4u << 20;
+    const uint32_t DEFAULT_TRANSIENT_FRAMES = 3;
+}
+
 struct graphics_device::impl {
     std::unique_ptr<draw_immediate> mDrawImmediate;
 
     std::shared_ptr<vertex_format> mStdVertexFormats[STD_VTX_FMT_COUNT];
 
+    std::unique_ptr<transient_arena> mTransient;
+    uint32_t mTransientBytes;
+    uint32_t mTransientFrames;
+
+    transient_arena& get_transient(graphics_device& pDevice) {
+        if (!mTransient) {
+            mTransient = pDevice.make_transient_arena(mTransientBytes,
+                mTransientFrames);
+        }
+        return *mTransient;
+    }
+
     std::unique_ptr<vertex_format>
     make_std_vtx_fmt_pc(graphics_device& pDevice) {
         auto vf = pDevice.make_vertex_format("STD_PC");
@@ -18,7 +36,10 @@ struct graphics_device::impl {
         return vf;
     }
 
-    impl(graphics_device& pDevice) {
+    impl(graphics_device& pDevice)
+        : mTransientBytes(DEFAULT_TRANSIENT_BYTES_PER_FRAME),
+          mTransientFrames(DEFAULT_TRANSIENT_FRAMES)
+    {
     }
 
     void init(graphics_device& pDevice) {
@@ -80,6 +101,7 @@ graphics_device::graphics_device()
     mVertexBufferDirty = true;
     mIndexBufferDirty = true;
     mRTDirty = true;
+    mStateDirty = true;
 }
 
 
@@ -100,6 +122,9 @@ graphics_device::begin_frame()
 {
     mStatistics.clear();
     update_state();
+    if (mPImpl->mTransient) {
+        mPImpl->mTransient->begin_frame();
+    }
     begin_frame_internal();
 }
 
@@ -107,10 +132,70 @@ graphics_device::begin_frame()
 void
 graphics_device::end_frame()
 {
+    mPImpl->mDrawImmediate->flush();
+    if (mPImpl->mTransient) {
+        mPImpl->mTransient->end_frame();
+    }
     end_frame_internal();
 }
 
 
+transient_vertices_t
+graphics_device::alloc_transient_vertices(
+        const std::shared_ptr<vertex_format>& pFmt, uint32_t pVertexCount)
+{
+    transient_arena& arena = mPImpl->get_transient(*this);
+    uint32_t size = pFmt->size();
+    uint32_t offset;
+    transient_vertices_t v;
+    v.mData = arena.allocate(size * pVertexCount, size, &offset);
+    v.mBuffer = arena.vertex_view(pFmt);
+    v.mVertexStart = offset / size;
+    return v;
+}
+
+
+transient_indices_t
+graphics_device::alloc_transient_indices(index_type_t pType,
+        uint32_t pIndexCount)
+{
+    transient_arena& arena = mPImpl->get_transient(*this);
+    uint32_t size = index_type_size(pType);
+    uint32_t offset;
+    transient_indices_t i;
+    i.mData = arena.allocate(size * pIndexCount, size, &offset);
+    i.mBuffer = arena.index_view(pType);
+    i.mIndexStart = offset / size;
+    return i;
+}
+
+
+void
+graphics_device::set_transient_arena_size(uint32_t pBytesPerFrame,
+        uint32_t pFrames)
+{
+    if (mPImpl->mTransient) {
+        throw std::logic_error("graphics_device::set_transient_arena_size");
+    }
+    mPImpl->mTransientBytes = pBytesPerFrame;
+    mPImpl->mTransientFrames = pFrames;
+}
+
+
+transient_arena*
+graphics_device::get_transient_arena()
+{
+    return mPImpl->mTransient.get();
+}
+
+
+transient_arena&
+graphics_device::use_transient_arena()
+{
+    return mPImpl->get_transient(*this);
+}
+
+
 std::shared_ptr<vertex_format>
 graphics_device::standard_vertex_format(standard_vertex_format_t pFmt) {
     if (pFmt >= STD_VTX_FMT_COUNT) {
@@ -120,6 +205,25 @@ graphics_device::standard_vertex_format(standard_vertex_format_t pFmt) {
 }
 
 
+void
+graphics_device::draw_mesh_primitives(const mesh& pMesh)
+{
+    if (pMesh.indexed()) {
+        draw_indexed_primitive(pMesh.primitive_type(),
+            pMesh.get_index_buffer()->index_type(), pMesh.index_start(),
+            pMesh.primitive_count());
+    }
+    else if (pMesh.range_count()) {
+        draw_primitive_ranges(pMesh.primitive_type(), pMesh.range_starts(),
+            pMesh.range_primitive_counts(), pMesh.range_count());
+    }
+    else {
+        draw_primitive(pMesh.primitive_type(), pMesh.vertex_start(),
+            pMesh.primitive_count());
+    }
+}
+
+
 void
 graphics_device::set_vertex_buffer(std::shared_ptr<vertex_buffer> pBuf)
 {
@@ -138,6 +242,24 @@ graphics_device::set_vertex_buffer(std::shared_ptr<vertex_buffer> pBuf)
 }
 
 
+void
+graphics_device::set_index_buffer(std::shared_ptr<index_buffer> pBuf)
+{
+    if (pBuf == mCurrIB) {
+        return;
+    }
+    if (!mIndexBufferDirty) {
+        if (mPrevIB) {
+            mPrevIB->deselect();
+        }
+        mPrevIB = std::move(mCurrIB);
+    }
+    mIndexBufferDirty = true;
+    mAnythingDirty = true;
+    mCurrIB = std::move(pBuf);
+}
+
+
 void
 graphics_device::set_render_target(std::shared_ptr<render_target> pTarget)
 {
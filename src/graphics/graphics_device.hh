@@ -16,6 +16,29 @@ namespace trillek {
     class draw_immediate;
     class mesh;
     class graphics_state;
+    class transient_arena;
+
+    // One instance's attributes for graphics_device::draw_instanced().
+    struct instance_t {
+        matrix4_t mTransform;
+        float_t mColor[4];
+    };
+
+    // Space for vertices or indices which only live until the end of the
+    // frame. mData is where to write them, and is valid until the device
+    // next draws; draw them from mBuffer starting at mVertexStart or
+    // mIndexStart.
+    struct transient_vertices_t {
+        std::shared_ptr<vertex_buffer> mBuffer;
+        uint32_t mVertexStart;
+        void* mData;
+    };
+
+    struct transient_indices_t {
+        std::shared_ptr<index_buffer> mBuffer;
+        uint32_t mIndexStart;
+        void* mData;
+    };
 
     struct graphics_device_statistics {
         std::array<uint32_t, STAT_LAST> mStats;
@@ -60,19 +83,82 @@ namespace trillek {
         virtual std::unique_ptr<vertex_format>
         make_vertex_format(std::string pFormat) = 0;
 
+        // Meshes of polygons or quads can't be drawn by a core profile GL
+        // device, which throws; triangulate them with indexed_mesh_builder.
         virtual std::unique_ptr<mesh>
         make_mesh(primitive_type_t pType,
                 const std::shared_ptr<vertex_format>& pFmt,
                 uint32_t mCount, buffer_lifetime_t pLifetime) = 0;
 
+        // A mesh holding one range per entry in pPrimitiveCounts, all in
+        // a single vertex buffer and drawn with a single call.
+        virtual std::unique_ptr<mesh>
+        make_batch_mesh(primitive_type_t pType,
+                const std::shared_ptr<vertex_format>& pFmt,
+                const std::vector<uint32_t>& pPrimitiveCounts,
+                buffer_lifetime_t pLifetime) = 0;
+
+        // A mesh whose pVertexCount vertices are drawn through pIndexCount
+        // indices of type pIndexType.
+        virtual std::unique_ptr<mesh>
+        make_indexed_mesh(primitive_type_t pType,
+                const std::shared_ptr<vertex_format>& pFmt,
+                uint32_t pVertexCount, index_type_t pIndexType,
+                uint32_t pIndexCount, buffer_lifetime_t pLifetime) = 0;
+
         virtual std::unique_ptr<vertex_buffer>
         make_vertex_buffer(std::shared_ptr<vertex_format> pFmt,
                 uint32_t pVertCount, buffer_lifetime_t pLifetime) = 0;
 
+        virtual std::unique_ptr<index_buffer>
+        make_index_buffer(index_type_t pType, uint32_t pIndexCount,
+                buffer_lifetime_t pLifetime) = 0;
+
+        // Per-frame vertex and index space, handed out without any driver
+        // allocation or stall. Throws if the frame's share of the transient
+        // arena runs out.
+        transient_vertices_t
+        alloc_transient_vertices(const std::shared_ptr<vertex_format>& pFmt,
+                uint32_t pVertexCount);
+
+        transient_indices_t
+        alloc_transient_indices(index_type_t pType, uint32_t pIndexCount);
+
+        // Size the transient arena: pBytesPerFrame for each of pFrames
+        // frames in flight. Must be called before the first allocation.
+        void set_transient_arena_size(uint32_t pBytesPerFrame,
+                uint32_t pFrames = 3);
+
         void set_vertex_buffer(std::shared_ptr<vertex_buffer> pBuf);
 
+        void set_index_buffer(std::shared_ptr<index_buffer> pBuf);
+
+        const std::shared_ptr<vertex_buffer>& get_vertex_buffer() const
+        {
+            return mCurrVB;
+        }
+
         virtual void draw_primitive(primitive_type_t pType, uint32_t pVertexStart, uint32_t pPrimitiveCount) = 0;
 
+        // Draw pRanges separate runs of primitives from the current vertex
+        // buffer in one call.
+        virtual void draw_primitive_ranges(primitive_type_t pType,
+                const uint32_t* pVertexStarts,
+                const uint32_t* pPrimitiveCounts, uint32_t pRanges) = 0;
+
+        // Draw primitives from the current index buffer, whose indices are
+        // of type pIndexType, starting at index pIndexStart.
+        virtual void draw_indexed_primitive(primitive_type_t pType,
+                index_type_t pIndexType, uint32_t pIndexStart,
+                uint32_t pPrimitiveCount) = 0;
+
+        // Draw pMesh once for each of pInstances. An instance's transform
+        // takes the place of the model transform, and its colour is used
+        // for meshes with no per-vertex colour. The current state must be
+        // up to date.
+        virtual void draw_instanced(mesh& pMesh,
+                const instance_t* pInstances, uint32_t pCount) = 0;
+
         virtual std::shared_ptr<window_target> make_window_target(
                 const std::shared_ptr<window>& pWindow) = 0;
 
@@ -90,6 +176,12 @@ namespace trillek {
         }
 
         void set_graphics_state(std::shared_ptr<graphics_state> pState);
+
+        const std::shared_ptr<graphics_state>& get_graphics_state() const
+        {
+            return mCurrState;
+        }
+
         void push_graphics_state();
         void pop_graphics_state();
 
@@ -113,6 +205,18 @@ namespace trillek {
         virtual void begin_frame_internal() = 0;
         virtual void end_frame_internal() = 0;
 
+        virtual std::unique_ptr<transient_arena>
+        make_transient_arena(uint32_t pRegionBytes, uint32_t pRegions) = 0;
+
+        // The transient arena, if anything has been allocated from it yet.
+        transient_arena* get_transient_arena();
+
+        // The transient arena, made on first use.
+        transient_arena& use_transient_arena();
+
+        // Issue pMesh's draw call, with its buffers already selected.
+        void draw_mesh_primitives(const mesh& pMesh);
+
         bool mAnythingDirty;
 
         bool mModelXformDirty;
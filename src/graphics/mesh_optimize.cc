@@ -0,0 +1,259 @@
+#include <mesh_optimize.hh>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace trillek {
+
+namespace {
+
+    // Forsyth's scoring parameters, as published.
+    static constexpr uint32_t SCORE_CACHE_SIZE = 32;
+    static constexpr float_t LAST_TRIANGLE_SCORE = 0.75f;
+    static constexpr float_t CACHE_DECAY_POWER = 1.5f;
+    static constexpr float_t VALENCE_BOOST_SCALE = 2.0f;
+    static constexpr float_t VALENCE_BOOST_POWER = 0.5f;
+
+    static constexpr uint32_t NO_TRIANGLE = ~0u;
+
+    // Tables of the score for each cache position and remaining valence,
+    // so the inner loop doesn't call pow().
+    struct score_table {
+        float_t mCache[SCORE_CACHE_SIZE];
+        float_t mValence[64];
+
+        score_table() {
+            for (uint32_t i = 0; i < SCORE_CACHE_SIZE; ++i) {
+                if (i < 3) {
+                    mCache[i] = LAST_TRIANGLE_SCORE;
+                }
+                else {
+                    float_t scale = 1.0f / (SCORE_CACHE_SIZE - 3);
+                    mCache[i] = std::pow(1.0f - (i - 3) * scale,
+                            CACHE_DECAY_POWER);
+                }
+            }
+            for (uint32_t i = 0; i < 64; ++i) {
+                mValence[i] = i == 0 ? 0 : VALENCE_BOOST_SCALE
+                    * std::pow((float_t)i, -VALENCE_BOOST_POWER);
+            }
+        }
+
+        float_t score(int32_t pCachePos, uint32_t pRemaining) const {
+            if (pRemaining == 0) {
+                return -1;
+            }
+            float_t s = pCachePos < 0 ? 0 : mCache[pCachePos];
+            return s + mValence[pRemaining < 64 ? pRemaining : 63];
+        }
+    };
+
+    const score_table sScores;
+
+}
+
+
+float_t
+vertex_cache_acmr(const uint32_t* pIndices, uint32_t pIndexCount,
+        uint32_t pVertexCount, uint32_t pCacheSize)
+{
+    if (pIndexCount < 3) {
+        return 0;
+    }
+
+    // A vertex is in the FIFO if it was loaded fewer than pCacheSize
+    // misses ago.
+    std::vector<uint32_t> loadedAt(pVertexCount, 0);
+    uint32_t misses = 0;
+    for (uint32_t i = 0; i < pIndexCount; ++i) {
+        uint32_t v = pIndices[i];
+        if (!loadedAt[v] || misses + 1 - loadedAt[v] > pCacheSize) {
+            ++misses;
+            loadedAt[v] = misses;
+        }
+    }
+    return (float_t)misses / (pIndexCount / 3);
+}
+
+
+void
+optimize_vertex_cache(uint32_t* pIndices, uint32_t pIndexCount,
+        uint32_t pVertexCount)
+{
+    uint32_t triangles = pIndexCount / 3;
+    if (triangles < 2) {
+        return;
+    }
+
+    // Each vertex's triangles, as ranges of one shared array.
+    std::vector<uint32_t> remaining(pVertexCount, 0);
+    for (uint32_t i = 0; i < triangles * 3; ++i) {
+        ++remaining[pIndices[i]];
+    }
+    std::vector<uint32_t> firstTri(pVertexCount + 1, 0);
+    for (uint32_t v = 0; v < pVertexCount; ++v) {
+        firstTri[v + 1] = firstTri[v] + remaining[v];
+    }
+    std::vector<uint32_t> vertexTris(triangles * 3);
+    {
+        std::vector<uint32_t> fill(firstTri.begin(), firstTri.end() - 1);
+        for (uint32_t i = 0; i < triangles * 3; ++i) {
+            vertexTris[fill[pIndices[i]]++] = i / 3;
+        }
+    }
+
+    std::vector<float_t> vertexScore(pVertexCount);
+    for (uint32_t v = 0; v < pVertexCount; ++v) {
+        vertexScore[v] = sScores.score(-1, remaining[v]);
+    }
+
+    std::vector<float_t> triScore(triangles);
+    std::vector<bool> emitted(triangles, false);
+    for (uint32_t t = 0; t < triangles; ++t) {
+        triScore[t] = vertexScore[pIndices[t * 3]]
+            + vertexScore[pIndices[t * 3 + 1]]
+            + vertexScore[pIndices[t * 3 + 2]];
+    }
+
+    std::vector<uint32_t> output;
+    output.reserve(triangles * 3);
+
+    // One slot more than the cache, for the vertices pushed out.
+    uint32_t cache[SCORE_CACHE_SIZE + 3];
+    uint32_t cacheUsed = 0;
+
+    uint32_t best = 0;
+    for (uint32_t t = 1; t < triangles; ++t) {
+        if (triScore[t] > triScore[best]) {
+            best = t;
+        }
+    }
+    uint32_t scan = 0;
+
+    while (best != NO_TRIANGLE) {
+        const uint32_t* tri = &pIndices[best * 3];
+        output.insert(output.end(), tri, tri + 3);
+        emitted[best] = true;
+
+        // Move the triangle's vertices to the front of the LRU cache.
+        uint32_t next[SCORE_CACHE_SIZE + 3];
+        uint32_t nextUsed = 0;
+        for (uint32_t k = 0; k < 3; ++k) {
+            uint32_t v = tri[k];
+            next[nextUsed++] = v;
+            --remaining[v];
+            uint32_t* vt = &vertexTris[firstTri[v]];
+            uint32_t* vtEnd = vt + remaining[v] + 1;
+            for (; vt != vtEnd; ++vt) {
+                if (*vt == best) {
+                    std::swap(*vt, vtEnd[-1]);
+                    break;
+                }
+            }
+        }
+        for (uint32_t i = 0; i < cacheUsed; ++i) {
+            uint32_t v = cache[i];
+            if (v != tri[0] && v != tri[1] && v != tri[2]) {
+                next[nextUsed++] = v;
+            }
+        }
+
+        // Rescore everything which was or is in the cache, and the
+        // triangles still waiting on those vertices.
+        for (uint32_t i = 0; i < nextUsed; ++i) {
+            uint32_t v = next[i];
+            int32_t pos = i < SCORE_CACHE_SIZE ? (int32_t)i : -1;
+            float_t score = sScores.score(pos, remaining[v]);
+            float_t delta = score - vertexScore[v];
+            vertexScore[v] = score;
+
+            const uint32_t* vt = &vertexTris[firstTri[v]];
+            for (uint32_t j = 0; j < remaining[v]; ++j) {
+                triScore[vt[j]] += delta;
+            }
+        }
+
+        best = NO_TRIANGLE;
+        float_t bestScore = -1;
+        for (uint32_t i = 0; i < nextUsed && i < SCORE_CACHE_SIZE; ++i) {
+            uint32_t v = next[i];
+            const uint32_t* vt = &vertexTris[firstTri[v]];
+            for (uint32_t j = 0; j < remaining[v]; ++j) {
+                if (triScore[vt[j]] > bestScore) {
+                    bestScore = triScore[vt[j]];
+                    best = vt[j];
+                }
+            }
+        }
+        cacheUsed = std::min(nextUsed, SCORE_CACHE_SIZE);
+        std::copy(next, next + cacheUsed, cache);
+
+        // Nothing in the cache is left to draw; start somewhere new.
+        if (best == NO_TRIANGLE) {
+            while (scan < triangles && emitted[scan]) {
+                ++scan;
+            }
+            if (scan < triangles) {
+                best = scan;
+            }
+        }
+    }
+
+    std::copy(output.begin(), output.end(), pIndices);
+}
+
+
+uint32_t
+optimize_vertex_fetch(uint8_t* pVertices, uint32_t pVertexSize,
+        uint32_t pVertexCount, uint32_t* pIndices, uint32_t pIndexCount)
+{
+    static constexpr uint32_t UNUSED = ~0u;
+
+    std::vector<uint32_t> remap(pVertexCount, UNUSED);
+    uint32_t used = 0;
+    for (uint32_t i = 0; i < pIndexCount; ++i) {
+        uint32_t& r = remap[pIndices[i]];
+        if (r == UNUSED) {
+            r = used++;
+        }
+        pIndices[i] = r;
+    }
+
+    std::vector<uint8_t> moved(used * pVertexSize);
+    for (uint32_t v = 0; v < pVertexCount; ++v) {
+        if (remap[v] != UNUSED) {
+            std::memcpy(&moved[remap[v] * pVertexSize],
+                    &pVertices[v * pVertexSize], pVertexSize);
+        }
+    }
+    std::memcpy(pVertices, moved.data(), moved.size());
+    return used;
+}
+
+
+vertex_cache_stats
+optimize_triangle_list(std::vector<uint8_t>& pVertices, uint32_t pVertexSize,
+        std::vector<uint32_t>& pIndices)
+{
+    if (pIndices.size() % 3) {
+        throw std::logic_error("optimize_triangle_list");
+    }
+
+    vertex_cache_stats stats;
+    uint32_t vertices = pVertices.size() / pVertexSize;
+    stats.mVerticesBefore = vertices;
+    stats.mAcmrBefore = vertex_cache_acmr(pIndices.data(), pIndices.size(),
+            vertices);
+
+    optimize_vertex_cache(pIndices.data(), pIndices.size(), vertices);
+    vertices = optimize_vertex_fetch(pVertices.data(), pVertexSize, vertices,
+            pIndices.data(), pIndices.size());
+    pVertices.resize(vertices * pVertexSize);
+
+    stats.mVerticesAfter = vertices;
+    stats.mAcmrAfter = vertex_cache_acmr(pIndices.data(), pIndices.size(),
+            vertices);
+    return stats;
+}
+
+}
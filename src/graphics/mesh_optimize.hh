@@ -0,0 +1,47 @@
+#ifndef MESH_OPTIMIZE_HH_INCLUDED
+#define MESH_OPTIMIZE_HH_INCLUDED
+
+#include <utils.hh>
+#include <maths.hh>
+
+namespace trillek {
+
+    // The FIFO size used to measure post-transform cache behaviour. It's
+    // at the small end of what current hardware has, so an ordering which
+    // does well here does at least as well on the real thing.
+    static constexpr uint32_t VERTEX_CACHE_SIZE = 16;
+
+    struct vertex_cache_stats {
+        float_t mAcmrBefore;
+        float_t mAcmrAfter;
+        uint32_t mVerticesBefore;
+        uint32_t mVerticesAfter;
+    };
+
+    // Average cache miss ratio: vertices transformed per triangle when
+    // pIndices, a triangle list, is drawn through a FIFO cache of
+    // pCacheSize entries. 3 is the worst possible and 0.5 about the best
+    // a regular grid can do.
+    float_t vertex_cache_acmr(const uint32_t* pIndices, uint32_t pIndexCount,
+            uint32_t pVertexCount, uint32_t pCacheSize = VERTEX_CACHE_SIZE);
+
+    // Reorder the triangles of a triangle list for post-transform cache
+    // hits, using Forsyth's linear-speed greedy algorithm. Each triangle
+    // keeps its winding.
+    void optimize_vertex_cache(uint32_t* pIndices, uint32_t pIndexCount,
+            uint32_t pVertexCount);
+
+    // Renumber vertices in the order the indices first use them, moving
+    // their bytes to match, so that vertex fetch walks through memory.
+    // Unreferenced vertices are dropped. Returns the new vertex count.
+    uint32_t optimize_vertex_fetch(uint8_t* pVertices, uint32_t pVertexSize,
+            uint32_t pVertexCount, uint32_t* pIndices, uint32_t pIndexCount);
+
+    // Both passes above over a triangle list, with the ACMR measured
+    // before and after.
+    vertex_cache_stats optimize_triangle_list(std::vector<uint8_t>& pVertices,
+            uint32_t pVertexSize, std::vector<uint32_t>& pIndices);
+
+}
+
+#endif // MESH_OPTIMIZE_HH_INCLUDED
@@ -0,0 +1,518 @@
+#include <graphics_device_null.hh>
+#include <graphics_state.hh>
+#include <primitive.hh>
+#include <transient_arena.hh>
+
+namespace trillek {
+
+namespace {
+
+struct vertex_format_null : public vertex_format {
+    vertex_format_null(std::string pDescription)
+        : vertex_format(pDescription)
+    {
+    }
+
+    void update_device() {
+    }
+};
+
+
+struct vertex_buffer_null : public vertex_buffer {
+    graphics_device_null& mDevice;
+    std::vector<uint8_t> mData;
+
+    vertex_buffer_null(graphics_device_null& pDevice,
+                buffer_lifetime_t pLifetime,
+                std::shared_ptr<vertex_format> pFormat,
+                uint32_t pVertexCount)
+        : vertex_buffer(pLifetime, std::move(pFormat), pVertexCount),
+          mDevice(pDevice), mData(pVertexCount * mFormat->size())
+    {
+    }
+
+    void* lock(uint32_t pVertexStart, uint32_t pVertexCount) {
+        uint32_t vertexSize = mFormat->size();
+        if (pVertexStart + pVertexCount > mVertexCount) {
+            throw std::logic_error("vertex_buffer_null::lock");
+        }
+        mDevice.count(NULL_LOCKS);
+        mDevice.count(NULL_BYTES_LOCKED, pVertexCount * vertexSize);
+        return mData.data() + pVertexStart * vertexSize;
+    }
+
+    void unlock() {
+    }
+
+    void select() {
+    }
+
+    void deselect() {
+    }
+};
+
+
+struct index_buffer_null : public index_buffer {
+    graphics_device_null& mDevice;
+    std::vector<uint8_t> mData;
+
+    index_buffer_null(graphics_device_null& pDevice,
+                buffer_lifetime_t pLifetime, index_type_t pType,
+                uint32_t pIndexCount)
+        : index_buffer(pLifetime, pType, pIndexCount),
+          mDevice(pDevice), mData(pIndexCount * index_type_size(pType))
+    {
+    }
+
+    void* lock(uint32_t pIndexStart, uint32_t pIndexCount) {
+        uint32_t indexSize = index_type_size(mIndexType);
+        if (pIndexStart + pIndexCount > mIndexCount) {
+            throw std::logic_error("index_buffer_null::lock");
+        }
+        mDevice.count(NULL_LOCKS);
+        mDevice.count(NULL_BYTES_LOCKED, pIndexCount * indexSize);
+        return mData.data() + pIndexStart * indexSize;
+    }
+
+    void unlock() {
+    }
+
+    void select() {
+    }
+
+    void deselect() {
+    }
+};
+
+
+// Views of the transient arena have no storage of their own.
+struct transient_vertex_view_null : public vertex_buffer {
+    transient_vertex_view_null(std::shared_ptr<vertex_format> pFormat,
+                uint32_t pVertexCount)
+        : vertex_buffer(BUFFER_VOLATILE, std::move(pFormat), pVertexCount)
+    {
+    }
+
+    void* lock(uint32_t pVertexStart, uint32_t pVertexCount) {
+        throw std::logic_error("transient_vertex_view_null::lock");
+    }
+
+    void unlock() {
+    }
+
+    void select() {
+    }
+
+    void deselect() {
+    }
+};
+
+
+struct transient_index_view_null : public index_buffer {
+    transient_index_view_null(index_type_t pType, uint32_t pIndexCount)
+        : index_buffer(BUFFER_VOLATILE, pType, pIndexCount)
+    {
+    }
+
+    void* lock(uint32_t pIndexStart, uint32_t pIndexCount) {
+        throw std::logic_error("transient_index_view_null::lock");
+    }
+
+    void unlock() {
+    }
+
+    void select() {
+    }
+
+    void deselect() {
+    }
+};
+
+
+// Nothing runs behind the CPU, so fences are always signalled.
+class transient_arena_null : public transient_arena {
+public:
+    transient_arena_null(graphics_device_null& pDevice,
+                uint32_t pRegionBytes, uint32_t pRegions)
+        : transient_arena(pRegionBytes, pRegions),
+          mDevice(pDevice), mData(pRegionBytes * pRegions)
+    {
+    }
+
+protected:
+    void wait_region(uint32_t pRegion) {
+    }
+
+    void fence_region(uint32_t pRegion) {
+        mDevice.count(NULL_FENCES);
+    }
+
+    uint8_t* map_range(uint32_t pOffset, uint32_t pBytes) {
+        mDevice.count(NULL_TRANSIENT_MAPS);
+        return mData.data() + pOffset;
+    }
+
+    void unmap_range() {
+    }
+
+    std::shared_ptr<vertex_buffer>
+    make_vertex_view(std::shared_ptr<vertex_format> pFormat) {
+        uint32_t count = mData.size() / pFormat->size();
+        return std::make_shared<transient_vertex_view_null>(
+            std::move(pFormat), count);
+    }
+
+    std::shared_ptr<index_buffer> make_index_view(index_type_t pType) {
+        uint32_t count = mData.size() / index_type_size(pType);
+        return std::make_shared<transient_index_view_null>(pType, count);
+    }
+
+private:
+    graphics_device_null& mDevice;
+    std::vector<uint8_t> mData;
+};
+
+
+class mesh_null : public mesh {
+public:
+    mesh_null(const std::shared_ptr<graphics_device_null>& pDevice,
+                buffer_lifetime_t pLifetime, primitive_type_t pType,
+                const std::shared_ptr<vertex_format>& pFormat,
+                uint32_t pPrimitiveCount)
+        : mesh(pDevice)
+    {
+        mType = pType;
+        mPrimitiveCount = pPrimitiveCount;
+        mVertexStart = 0;
+        mVertexCount = primitive_vertex_count(pType, pPrimitiveCount);
+        mVertexBuffer = pDevice->make_vertex_buffer(pFormat, mVertexCount,
+                pLifetime);
+    }
+
+    mesh_null(const std::shared_ptr<graphics_device_null>& pDevice,
+                buffer_lifetime_t pLifetime, primitive_type_t pType,
+                const std::shared_ptr<vertex_format>& pFormat,
+                const std::vector<uint32_t>& pPrimitiveCounts)
+        : mesh(pDevice)
+    {
+        mType = pType;
+        set_ranges(pPrimitiveCounts);
+        mVertexBuffer = pDevice->make_vertex_buffer(pFormat, mVertexCount,
+                pLifetime);
+    }
+
+    mesh_null(const std::shared_ptr<graphics_device_null>& pDevice,
+                buffer_lifetime_t pLifetime, primitive_type_t pType,
+                const std::shared_ptr<vertex_format>& pFormat,
+                uint32_t pVertexCount, index_type_t pIndexType,
+                uint32_t pIndexCount)
+        : mesh(pDevice)
+    {
+        mType = pType;
+        mPrimitiveCount = vertex_primitive_count(pType, pIndexCount);
+        mVertexStart = 0;
+        mVertexCount = pVertexCount;
+        mIndexStart = 0;
+        mIndexCount = pIndexCount;
+        mIndexBuffer = pDevice->make_index_buffer(pIndexType, mIndexCount,
+                pLifetime);
+        mVertexBuffer = pDevice->make_vertex_buffer(pFormat, mVertexCount,
+                pLifetime);
+    }
+
+    void select() {
+    }
+
+    void deselect() {
+    }
+
+    void draw() {
+        std::shared_ptr<graphics_device> device(mDevice);
+        if (mIndexBuffer) {
+            device->draw_indexed_primitive(mType, mIndexBuffer->index_type(),
+                mIndexStart, mPrimitiveCount);
+        }
+        else if (mRangeStarts.empty()) {
+            device->draw_primitive(mType, mVertexStart, mPrimitiveCount);
+        }
+        else {
+            device->draw_primitive_ranges(mType, mRangeStarts.data(),
+                mRangePrimitiveCounts.data(), mRangeStarts.size());
+        }
+    }
+};
+
+}
+
+
+void
+null_device_counters::clear() {
+    for (auto& c : mCounts) {
+        c = 0;
+    }
+}
+
+
+graphics_device_null::graphics_device_null()
+{
+    mCounters.clear();
+    init();
+}
+
+
+graphics_device_null::~graphics_device_null()
+{
+}
+
+
+std::unique_ptr<vertex_format>
+graphics_device_null::make_vertex_format(std::string pName) {
+    count(NULL_VERTEX_FORMATS_MADE);
+    return std::unique_ptr<vertex_format>(
+        new vertex_format_null(pName)
+    );
+}
+
+
+std::unique_ptr<vertex_buffer>
+graphics_device_null::make_vertex_buffer(std::shared_ptr<vertex_format> pFormat,
+            uint32_t pVertexCount, buffer_lifetime_t pLifetime) {
+    count(NULL_VERTEX_BUFFERS_MADE);
+    return std::unique_ptr<vertex_buffer>(
+        new vertex_buffer_null(*this, pLifetime, std::move(pFormat),
+                pVertexCount)
+    );
+}
+
+
+std::unique_ptr<index_buffer>
+graphics_device_null::make_index_buffer(index_type_t pType,
+            uint32_t pIndexCount, buffer_lifetime_t pLifetime) {
+    count(NULL_INDEX_BUFFERS_MADE);
+    return std::unique_ptr<index_buffer>(
+        new index_buffer_null(*this, pLifetime, pType, pIndexCount)
+    );
+}
+
+
+std::unique_ptr<transient_arena>
+graphics_device_null::make_transient_arena(uint32_t pRegionBytes,
+            uint32_t pRegions) {
+    return std::unique_ptr<transient_arena>(
+        new transient_arena_null(*this, pRegionBytes, pRegions)
+    );
+}
+
+
+std::unique_ptr<mesh>
+graphics_device_null::make_mesh(primitive_type_t pType,
+            const std::shared_ptr<vertex_format>& pFormat,
+            uint32_t pPrimitiveCount, buffer_lifetime_t pLifetime) {
+    count(NULL_MESHES_MADE);
+    return std::unique_ptr<mesh>(
+        new mesh_null(shared_from_this(), pLifetime, pType, pFormat,
+                pPrimitiveCount)
+    );
+}
+
+
+std::unique_ptr<mesh>
+graphics_device_null::make_batch_mesh(primitive_type_t pType,
+            const std::shared_ptr<vertex_format>& pFormat,
+            const std::vector<uint32_t>& pPrimitiveCounts,
+            buffer_lifetime_t pLifetime) {
+    count(NULL_MESHES_MADE);
+    return std::unique_ptr<mesh>(
+        new mesh_null(shared_from_this(), pLifetime, pType, pFormat,
+                pPrimitiveCounts)
+    );
+}
+
+
+std::unique_ptr<mesh>
+graphics_device_null::make_indexed_mesh(primitive_type_t pType,
+            const std::shared_ptr<vertex_format>& pFormat,
+            uint32_t pVertexCount, index_type_t pIndexType,
+            uint32_t pIndexCount, buffer_lifetime_t pLifetime) {
+    count(NULL_MESHES_MADE);
+    return std::unique_ptr<mesh>(
+        new mesh_null(shared_from_this(), pLifetime, pType, pFormat,
+                pVertexCount, pIndexType, pIndexCount)
+    );
+}
+
+
+void
+graphics_device_null::draw_primitive(primitive_type_t pType,
+        uint32_t pVertexStart, uint32_t pPrimitiveCount)
+{
+    count(NULL_DRAW_CALLS);
+    count(NULL_PRIMITIVES, pPrimitiveCount);
+    ++mStatistics.mStats[STAT_DRAW_CALLS];
+    mStatistics.mStats[STAT_POLY_COUNT] += pPrimitiveCount;
+}
+
+
+void
+graphics_device_null::draw_primitive_ranges(primitive_type_t pType,
+        const uint32_t* pVertexStarts, const uint32_t* pPrimitiveCounts,
+        uint32_t pRanges)
+{
+    uint32_t primitives = 0;
+    for (uint32_t i = 0; i < pRanges; ++i) {
+        primitives += pPrimitiveCounts[i];
+    }
+    count(NULL_DRAW_CALLS);
+    count(NULL_PRIMITIVES, primitives);
+    ++mStatistics.mStats[STAT_DRAW_CALLS];
+    mStatistics.mStats[STAT_POLY_COUNT] += primitives;
+}
+
+
+void
+graphics_device_null::draw_indexed_primitive(primitive_type_t pType,
+        index_type_t pIndexType, uint32_t pIndexStart,
+        uint32_t pPrimitiveCount)
+{
+    count(NULL_DRAW_CALLS);
+    count(NULL_PRIMITIVES, pPrimitiveCount);
+    ++mStatistics.mStats[STAT_DRAW_CALLS];
+    mStatistics.mStats[STAT_POLY_COUNT] += pPrimitiveCount;
+}
+
+
+// Counted as the single call a device with hardware instancing makes.
+void
+graphics_device_null::draw_instanced(mesh& pMesh,
+        const instance_t* pInstances, uint32_t pCount)
+{
+    uint64_t primitives = (uint64_t)pMesh.primitive_count() * pCount;
+    count(NULL_DRAW_CALLS);
+    count(NULL_INSTANCES, pCount);
+    count(NULL_PRIMITIVES, primitives);
+    ++mStatistics.mStats[STAT_DRAW_CALLS];
+    mStatistics.mStats[STAT_POLY_COUNT] += primitives;
+}
+
+
+std::shared_ptr<window_target>
+graphics_device_null::make_window_target(const std::shared_ptr<window>& pWindow)
+{
+    return pWindow->make_window_target(shared_from_this());
+}
+
+
+void
+graphics_device_null::clear(clear_flags_t pFlags, const rgba_t& pColor,
+                float_t pDepth, uint32_t pStencil)
+{
+    count(NULL_CLEARS);
+}
+
+
+void
+graphics_device_null::begin_frame_internal() {
+    count(NULL_FRAMES);
+}
+
+
+void
+graphics_device_null::end_frame_internal() {
+}
+
+
+void
+graphics_device_null::update_transforms_internal(bool pForce)
+{
+    if (mModelXformDirty || mCameraXformDirty || pForce) {
+        count(NULL_TRANSFORM_UPDATES);
+        mModelXformDirty = false;
+        mCameraXformDirty = false;
+    }
+
+    if (mProjectionXformDirty || pForce) {
+        count(NULL_TRANSFORM_UPDATES);
+        mProjectionXformDirty = false;
+    }
+}
+
+
+// Counts the state changes graphics_device_gl would have issued.
+void
+graphics_device_null::update_graphics_state_internal(bool pForce)
+{
+    count(NULL_STATE_UPDATES);
+    if (!mCurrState) {
+        return;
+    }
+
+    if (pForce || !mPrevState) {
+        count(NULL_STATE_CHANGES, 5);
+        return;
+    }
+
+    const graphics_state& prev = *mPrevState;
+    const graphics_state& curr = *mCurrState;
+    uint64_t changes = 0;
+    changes += curr.mColor.mFlags != prev.mColor.mFlags;
+    changes += curr.mDepth.mFlags[D_ENABLE] != prev.mDepth.mFlags[D_ENABLE];
+    changes += curr.mDepth.mDepthCmp != prev.mDepth.mDepthCmp;
+    changes += curr.mDepth.mDepthBias != prev.mDepth.mDepthBias;
+    changes += curr.mDepth.mFlags[D_WENABLE] != prev.mDepth.mFlags[D_WENABLE];
+    count(NULL_STATE_CHANGES, changes);
+}
+
+
+void
+graphics_device_null::update_vertex_buffer_internal()
+{
+    if (mPrevVB) {
+        mPrevVB->deselect();
+        mPrevVB = std::shared_ptr<vertex_buffer>();
+    }
+
+    if (mCurrVB) {
+        mCurrVB->select();
+    }
+    count(NULL_VERTEX_BUFFER_CHANGES);
+}
+
+
+void
+graphics_device_null::update_index_buffer_internal()
+{
+    if (mPrevIB) {
+        mPrevIB->deselect();
+        mPrevIB = std::shared_ptr<index_buffer>();
+    }
+
+    if (mCurrIB) {
+        mCurrIB->select();
+    }
+    count(NULL_INDEX_BUFFER_CHANGES);
+}
+
+
+void
+graphics_device_null::update_render_target_internal()
+{
+    if (mPrevRT) {
+        mPrevRT->deselect();
+        mPrevRT = std::shared_ptr<render_target>();
+    }
+
+    if (mCurrRT) {
+        mCurrRT->select();
+    }
+    count(NULL_TARGET_CHANGES);
+}
+
+
+void
+graphics_device_null::update_viewport_internal()
+{
+    count(NULL_VIEWPORT_CHANGES);
+}
+
+
+}
@@ -0,0 +1,136 @@
+#ifndef GRAPHICS_DEVICE_NULL_HH_INCLUDED
+#define GRAPHICS_DEVICE_NULL_HH_INCLUDED
+
+#include <graphics_device.hh>
+
+namespace trillek {
+
+    enum null_device_counter_t {
+        NULL_FRAMES = 0,
+        NULL_DRAW_CALLS,
+        NULL_PRIMITIVES,
+        NULL_INSTANCES,
+        NULL_CLEARS,
+        NULL_VERTEX_FORMATS_MADE,
+        NULL_VERTEX_BUFFERS_MADE,
+        NULL_INDEX_BUFFERS_MADE,
+        NULL_MESHES_MADE,
+        NULL_LOCKS,
+        NULL_BYTES_LOCKED,
+        NULL_TRANSIENT_MAPS,
+        NULL_FENCES,
+        NULL_TRANSFORM_UPDATES,
+        NULL_STATE_UPDATES,
+        NULL_STATE_CHANGES,
+        NULL_VERTEX_BUFFER_CHANGES,
+        NULL_INDEX_BUFFER_CHANGES,
+        NULL_TARGET_CHANGES,
+        NULL_VIEWPORT_CHANGES,
+        NULL_COUNTER_LAST
+    };
+
+    struct null_device_counters {
+        std::array<uint64_t, NULL_COUNTER_LAST> mCounts;
+
+        void clear();
+    };
+
+    // A graphics device which does no GPU work at all. Buffers are kept in
+    // system memory so that mesh building costs what it would on a real
+    // device, and every call which would reach the driver is counted
+    // instead. Use it to measure the engine's own submission overhead.
+    class graphics_device_null
+            : public graphics_device,
+              public std::enable_shared_from_this<graphics_device_null>
+    {
+    public:
+        graphics_device_null();
+
+        virtual ~graphics_device_null();
+
+        virtual std::unique_ptr<vertex_format>
+        make_vertex_format(std::string pName);
+
+        virtual std::unique_ptr<mesh>
+        make_mesh(primitive_type_t pType,
+                const std::shared_ptr<vertex_format>& pFmt,
+                uint32_t mCount, buffer_lifetime_t pLifetime);
+
+        virtual std::unique_ptr<mesh>
+        make_batch_mesh(primitive_type_t pType,
+                const std::shared_ptr<vertex_format>& pFmt,
+                const std::vector<uint32_t>& pPrimitiveCounts,
+                buffer_lifetime_t pLifetime);
+
+        virtual std::unique_ptr<mesh>
+        make_indexed_mesh(primitive_type_t pType,
+                const std::shared_ptr<vertex_format>& pFmt,
+                uint32_t pVertexCount, index_type_t pIndexType,
+                uint32_t pIndexCount, buffer_lifetime_t pLifetime);
+
+        virtual std::unique_ptr<vertex_buffer>
+        make_vertex_buffer(std::shared_ptr<vertex_format> pFmt,
+                uint32_t pVertCount, buffer_lifetime_t pLifetime);
+
+        virtual std::unique_ptr<index_buffer>
+        make_index_buffer(index_type_t pType, uint32_t pIndexCount,
+                buffer_lifetime_t pLifetime);
+
+        virtual std::unique_ptr<transient_arena>
+        make_transient_arena(uint32_t pRegionBytes, uint32_t pRegions);
+
+        virtual void draw_primitive(primitive_type_t pType, uint32_t pVertexStart, uint32_t pPrimitiveCount);
+
+        virtual void draw_primitive_ranges(primitive_type_t pType,
+                const uint32_t* pVertexStarts,
+                const uint32_t* pPrimitiveCounts, uint32_t pRanges);
+
+        virtual void draw_indexed_primitive(primitive_type_t pType,
+                index_type_t pIndexType, uint32_t pIndexStart,
+                uint32_t pPrimitiveCount);
+
+        virtual void draw_instanced(mesh& pMesh,
+                const instance_t* pInstances, uint32_t pCount);
+
+        virtual std::shared_ptr<window_target> make_window_target(
+                const std::shared_ptr<window>& pWindow);
+
+        virtual void clear(clear_flags_t pFlags, const rgba_t& pColor,
+                float_t pZ, uint32_t pStencil);
+
+        const null_device_counters& counters() const {
+            return mCounters;
+        }
+
+        void reset_counters() {
+            mCounters.clear();
+        }
+
+        void count(null_device_counter_t pCounter, uint64_t pAmount = 1) {
+            mCounters.mCounts[pCounter] += pAmount;
+        }
+
+    protected:
+        virtual void begin_frame_internal();
+        virtual void end_frame_internal();
+
+        virtual void update_transforms_internal(bool pForce);
+
+        virtual void update_graphics_state_internal(bool pForce);
+
+        virtual void update_vertex_buffer_internal();
+
+        virtual void update_index_buffer_internal();
+
+        virtual void update_render_target_internal();
+
+        virtual void update_viewport_internal();
+
+    private:
+        null_device_counters mCounters;
+    };
+
+}
+
+
+#endif // GRAPHICS_DEVICE_NULL_HH_INCLUDED
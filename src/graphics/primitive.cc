@@ -1,4 +1,7 @@
 #include <primitive.hh>
+#include <graphics_device.hh>
+#include <triangulate.hh>
+#include <algorithm>
 
 namespace trillek {
 
@@ -26,6 +29,99 @@ namespace {
         }
     }
 
+    static constexpr uint32_t WELD_EMPTY = ~0u;
+
+    // FNV-1a.
+    inline uint32_t
+    hash_vertex(const uint8_t* pData, uint32_t pSize) {
+        uint32_t h = 2166136261u;
+        for (uint32_t i = 0; i < pSize; ++i) {
+            h = (h ^ pData[i]) * 16777619u;
+        }
+        return h;
+    }
+
+}
+
+
+uint32_t
+index_type_size(index_type_t pType) {
+    switch (pType) {
+    case INDEX_16:
+        return 2;
+
+    case INDEX_32:
+        return 4;
+
+    default:
+        throw std::logic_error("index_type_size");
+    }
+}
+
+
+uint32_t
+primitive_vertex_count(primitive_type_t pType, uint32_t pPrimitiveCount) {
+    switch (pType) {
+    case PRIM_POINTS:
+    case PRIM_LINE_LOOP:
+    case PRIM_POLYGON:
+        return pPrimitiveCount;
+
+    case PRIM_LINES:
+        return pPrimitiveCount * 2;
+
+    case PRIM_LINE_STRIP:
+        return pPrimitiveCount + 1;
+
+    case PRIM_TRIANGLES:
+        return pPrimitiveCount * 3;
+
+    case PRIM_TRIANGLE_STRIP:
+    case PRIM_TRIANGLE_FAN:
+        return pPrimitiveCount + 2;
+
+    case PRIM_QUADS:
+        return pPrimitiveCount * 4;
+
+    case PRIM_QUAD_STRIP:
+        return (pPrimitiveCount + 1) * 2;
+
+    default:
+        throw std::logic_error("primitive_vertex_count");
+    }
+}
+
+
+uint32_t
+vertex_primitive_count(primitive_type_t pType, uint32_t pVertexCount) {
+    switch (pType) {
+    case PRIM_POINTS:
+    case PRIM_LINE_LOOP:
+    case PRIM_POLYGON:
+        return pVertexCount;
+
+    case PRIM_LINES:
+        return pVertexCount / 2;
+
+    case PRIM_LINE_STRIP:
+        return pVertexCount < 2 ? 0 : pVertexCount - 1;
+
+    case PRIM_TRIANGLES:
+        return pVertexCount / 3;
+
+    case PRIM_TRIANGLE_STRIP:
+    case PRIM_TRIANGLE_FAN:
+        return pVertexCount < 3 ? 0 : pVertexCount - 2;
+
+    case PRIM_QUADS:
+        return pVertexCount / 4;
+
+    case PRIM_QUAD_STRIP:
+        return pVertexCount < 4 ? 0 : pVertexCount / 2 - 1;
+
+    default:
+        throw std::logic_error("vertex_primitive_count");
+    }
 }
 
 
@@ -83,91 +179,240 @@ vertex_buffer::~vertex_buffer() {
 }
 
 
+index_buffer::~index_buffer() {
+}
+
+
 mesh::~mesh() {
 }
 
 
 void
-mesh_builder::setup() {
-    vertex_buffer& vertBuffer = *mMesh.mVertexBuffer;
+mesh::set_ranges(const std::vector<uint32_t>& pPrimitiveCounts) {
+    mRangeStarts.clear();
+    mRangeStarts.reserve(pPrimitiveCounts.size());
+    mRangePrimitiveCounts = pPrimitiveCounts;
+
+    mVertexStart = 0;
+    mVertexCount = 0;
+    mPrimitiveCount = 0;
+    for (auto count : pPrimitiveCounts) {
+        mRangeStarts.push_back(mVertexCount);
+        mVertexCount += primitive_vertex_count(mType, count);
+        mPrimitiveCount += count;
+    }
+}
 
-    const vertex_format& format = vertBuffer.format();
-    mVertexSize = format.size();
 
-    uint8_t* vertData
-        = (uint8_t*)vertBuffer.lock(mMesh.mVertexStart, mMesh.mVertexCount);
+void
+vertex_writer::setup(const vertex_format& pFormat, uint8_t* pVertex) {
+    mVertexSize = pFormat.size();
+    mCurrPosition = nullptr;
+    mCurrNormal = nullptr;
+    mCurrColor = nullptr;
 
     uint32_t textures = 0;
-    uint32_t elements = format.elements();
+    uint32_t elements = pFormat.elements();
     for (unsigned i = 0; i < elements; ++i) {
-        const vertex_element_t& e = format[i];
+        const vertex_element_t& e = pFormat[i];
         switch (e.mMeaning) {
         case VERTDATA_POSITION:
-            mCurrPosition = (float_t*)vertData;
+            mCurrPosition = (float_t*)pVertex;
             break;
 
         case VERTDATA_NORMAL:
-            mCurrNormal = (float_t*)vertData;
+            mCurrNormal = (float_t*)pVertex;
             break;
 
         case VERTDATA_TEXCOORD:
-            mTexCoords[textures] = (float_t*)vertData;
+            mTexCoords[textures] = (float_t*)pVertex;
             ++textures;
             break;
 
         case VERTDATA_COLOR:
-            mCurrColor = (uint8_t*)vertData;
+            mCurrColor = (uint8_t*)pVertex;
             break;
 
         default:
-            throw std::logic_error("mesh_builder::setup");
+            throw std::logic_error("vertex_writer::setup");
         }
-        vertData += vertdata_type_size(e.mType);
+        pVertex += vertdata_type_size(e.mType);
     }
 
     mTextures = textures;
 }
 
 
-/*
-// XXX This should be render system-specific if D3D doesn't support all of
-// these primitive types.
 void
-mesh_builder::build_indexes() {
-    index_buffer_lock ib(*mMesh.mIndexBuffer, mMesh.mIndexStart, mMesh.mIndexCount);;
-    
-    uint32_t icount = mMesh.mIndexCount;
-
-    switch (mMesh.mType) {
-        case PRIM_POINTS:
-        case PRIM_LINES:
-        case PRIM_TRIANGLES:
-        case PRIM_TRIANGLE_STRIP:
-        case PRIM_TRIANGLE_FAN:
-        case PRIM_LINE_STRIP:
-        case PRIM_QUADS:
-        case PRIM_QUAD_STRIP:
-        case PRIM_POLYGON:
-        {
-            // vertex count == index count
-            for (uint32_t i = 0; i < icount; ++i) {
-                ib[i] = (uint16_t)i;
-            }
+mesh_builder::setup() {
+    vertex_buffer& vertBuffer = *mMesh.mVertexBuffer;
+    vertex_writer::setup(vertBuffer.format(),
+        (uint8_t*)vertBuffer.lock(mMesh.mVertexStart, mMesh.mVertexCount));
+}
+
+
+mesh_builder::~mesh_builder() {
+    mMesh.mVertexBuffer->unlock();
+}
+
+
+indexed_mesh_builder::indexed_mesh_builder(primitive_type_t pType,
+            std::shared_ptr<vertex_format> pFormat)
+    : mType(pType), mFormat(std::move(pFormat)),
+      mScratch(mFormat->size())
+{
+    vertex_writer::setup(*mFormat, mScratch.data());
+    mPositionOffset = (uint8_t*)mCurrPosition - mScratch.data();
+    reset();
+}
+
+
+void
+indexed_mesh_builder::reset() {
+    std::fill(mScratch.begin(), mScratch.end(), 0);
+    mVertexCount = 0;
+    mVertices.clear();
+    mIndices.clear();
+    mWeldTable.assign(64, WELD_EMPTY);
+    mInPrimitive = false;
+    mOptimized = false;
+    mCacheStats = vertex_cache_stats();
+}
+
+
+void
+indexed_mesh_builder::advance() {
+    mIndices.push_back(weld());
+    mOptimized = false;
+    std::fill(mScratch.begin(), mScratch.end(), 0);
+}
+
+
+void
+indexed_mesh_builder::begin(primitive_type_t pType) {
+    if (mType != PRIM_TRIANGLES || mInPrimitive) {
+        throw std::logic_error("indexed_mesh_builder::begin");
+    }
+    mInPrimitive = true;
+    mPrimitiveType = pType;
+    mPrimitiveStart = mIndices.size();
+}
+
+
+// Replace the indices emitted since begin() with a triangle list.
+void
+indexed_mesh_builder::end() {
+    if (!mInPrimitive) {
+        throw std::logic_error("indexed_mesh_builder::end");
+    }
+    mInPrimitive = false;
+
+    uint32_t count = mIndices.size() - mPrimitiveStart;
+    mTriangles.clear();
+    if (mPrimitiveType == PRIM_POLYGON) {
+        if (!mCurrPosition) {
+            throw std::logic_error("indexed_mesh_builder::end");
+        }
+        mOutline.resize(count);
+        for (uint32_t i = 0; i < count; ++i) {
+            float_t p[3];
+            std::memcpy(p, &mVertices[mIndices[mPrimitiveStart + i]
+                * mVertexSize + mPositionOffset], sizeof(p));
+            mOutline[i].set(p[0], p[1], p[2]);
+        }
+        triangulate_polygon(mOutline.data(), count, mTriangles);
+    }
+    else {
+        triangle_list_indices(mPrimitiveType, count, mTriangles);
+    }
+
+    for (auto& t : mTriangles) {
+        t = mIndices[mPrimitiveStart + t];
+    }
+    mIndices.resize(mPrimitiveStart);
+    mIndices.insert(mIndices.end(), mTriangles.begin(), mTriangles.end());
+}
+
+
+// Find the scratch vertex among those already added, or add it.
+uint32_t
+indexed_mesh_builder::weld() {
+    if ((mVertexCount + 1) * 2 > mWeldTable.size()) {
+        rehash(mWeldTable.size() * 2);
+    }
+
+    const uint8_t* vertex = mScratch.data();
+    uint32_t mask = mWeldTable.size() - 1;
+    uint32_t slot = hash_vertex(vertex, mVertexSize) & mask;
+    for (;;) {
+        uint32_t v = mWeldTable[slot];
+        if (v == WELD_EMPTY) {
             break;
         }
+        if (!std::memcmp(&mVertices[v * mVertexSize], vertex, mVertexSize)) {
+            return v;
+        }
+        slot = (slot + 1) & mask;
+    }
 
-        default:
-        {
-            throw std::logic_error("mesh_builder::build_indexes");
+    mWeldTable[slot] = mVertexCount;
+    mVertices.insert(mVertices.end(), vertex, vertex + mVertexSize);
+    return mVertexCount++;
+}
+
+
+void
+indexed_mesh_builder::rehash(uint32_t pTableSize) {
+    mWeldTable.assign(pTableSize, WELD_EMPTY);
+    uint32_t mask = mWeldTable.size() - 1;
+    for (uint32_t v = 0; v < mVertexCount; ++v) {
+        uint32_t slot = hash_vertex(&mVertices[v * mVertexSize], mVertexSize)
+            & mask;
+        while (mWeldTable[slot] != WELD_EMPTY) {
+            slot = (slot + 1) & mask;
         }
+        mWeldTable[slot] = v;
     }
 }
-*/
 
 
-mesh_builder::~mesh_builder() {
-    // build_indexes();
-    mMesh.mVertexBuffer->unlock();
+const vertex_cache_stats&
+indexed_mesh_builder::optimize() {
+    if (mType != PRIM_TRIANGLES || mInPrimitive) {
+        throw std::logic_error("indexed_mesh_builder::optimize");
+    }
+    mCacheStats = optimize_triangle_list(mVertices, mVertexSize, mIndices);
+    mVertexCount = mCacheStats.mVerticesAfter;
+    mOptimized = true;
+
+    // Vertex numbers have changed under the weld table.
+    rehash(mWeldTable.size());
+    return mCacheStats;
+}
+
+
+std::unique_ptr<mesh>
+indexed_mesh_builder::build(graphics_device& pDevice,
+            buffer_lifetime_t pLifetime) {
+    if (mIndices.empty() || mInPrimitive) {
+        throw std::logic_error("indexed_mesh_builder::build");
+    }
+    if (mType == PRIM_TRIANGLES && !mOptimized) {
+        optimize();
+    }
+
+    std::unique_ptr<mesh> m = pDevice.make_indexed_mesh(mType, mFormat,
+            mVertexCount, index_type(), mIndices.size(), pLifetime);
+
+    vertex_buffer& vb = *m->mVertexBuffer;
+    std::memcpy(vb.lock(0, mVertexCount), mVertices.data(), mVertices.size());
+    vb.unlock();
+
+    index_buffer_lock ib(*m->mIndexBuffer, m->mIndexStart, m->mIndexCount);
+    for (uint32_t i = 0; i < mIndices.size(); ++i) {
+        ib.set(i, mIndices[i]);
+    }
+    return m;
 }
 
 }
@@ -4,11 +4,20 @@
 #include <graphics_constants.hh>
 #include <maths.hh>
 #include <vector3.hh>
+#include <mesh_optimize.hh>
 
 namespace trillek {
 
     class graphics_device;
 
+    // How many vertices pPrimitiveCount primitives of type pType use.
+    uint32_t primitive_vertex_count(primitive_type_t pType,
+            uint32_t pPrimitiveCount);
+
+    // How many whole primitives of type pType pVertexCount vertices make.
+    uint32_t vertex_primitive_count(primitive_type_t pType,
+            uint32_t pVertexCount);
+
     struct vertex_element_t {
         vertdata_meaning_t mMeaning;
         vertdata_type_t mType;
@@ -82,12 +91,13 @@ namespace trillek {
 
         virtual void deselect() = 0;
 
-        const vertex_format& format() {
+        const vertex_format& format() const {
             return *mFormat;
         }
 
     protected:
         friend class mesh_builder;
+        friend class indexed_mesh_builder;
         friend class vertex_buffer_builder_base;
 
         // Hooks for mesh_builder.
@@ -115,6 +125,13 @@ namespace trillek {
             mData = mBuffer.lock(0, mBuffer.mVertexCount);
         }
 
+        // Lock only part of the buffer; element 0 is pVertexStart.
+        vertex_buffer_builder_base(vertex_buffer& pBuffer,
+                uint32_t pVertexStart, uint32_t pVertexCount)
+                : mBuffer(pBuffer) {
+            mData = mBuffer.lock(pVertexStart, pVertexCount);
+        }
+
         ~vertex_buffer_builder_base() {
             mBuffer.unlock();
         }
@@ -132,11 +149,21 @@ namespace trillek {
         {
         }
 
+        vertex_buffer_builder(vertex_buffer& pBuffer,
+                uint32_t pVertexStart, uint32_t pVertexCount)
+                : vertex_buffer_builder_base(pBuffer, pVertexStart,
+                        pVertexCount)
+        {
+        }
+
         T& operator[](unsigned i) {
             return reinterpret_cast<T*>(mData)[i];
         }
     };
 
+    // Bytes per index of the given type.
+    uint32_t index_type_size(index_type_t pType);
+
     // XXX On multi-head systems, buffers need to be tied to a device.
     class index_buffer {
     public:
@@ -146,34 +173,57 @@ namespace trillek {
 
         virtual void deselect() = 0;
 
+        index_type_t index_type() const {
+            return mIndexType;
+        }
+
+        uint32_t index_count() const {
+            return mIndexCount;
+        }
+
     protected:
         friend class index_buffer_lock;
 
-        // Hooks for mesh_builder.
+        // Hooks for index_buffer_lock.
         virtual void* lock(uint32_t pIndexStart, uint32_t pIndexCount) = 0;
         virtual void unlock() = 0;
+
+        buffer_lifetime_t mLifetime;
+        index_type_t mIndexType;
+        uint32_t mIndexCount;
+
+        index_buffer(buffer_lifetime_t pLifetime, index_type_t pType,
+                uint32_t pIndexCount)
+            : mLifetime(pLifetime),
+              mIndexType(pType),
+              mIndexCount(pIndexCount)
+        {
+        }
     };
 
     class index_buffer_lock {
     private:
         index_buffer& mIB;
-        uint16_t* mData;
+        void* mData;
 
     public:
         index_buffer_lock(index_buffer& pIB,
                     uint32_t pIndexStart, uint32_t pIndexCount)
                 : mIB(pIB) {
-            mData = reinterpret_cast<uint16_t*>(
-                mIB.lock(pIndexStart, pIndexCount)
-            );
+            mData = mIB.lock(pIndexStart, pIndexCount);
         }
 
         ~index_buffer_lock() {
             mIB.unlock();
         }
 
-        uint16_t& operator[](unsigned i) {
-            return mData[i];
+        void set(unsigned i, uint32_t pIndex) {
+            if (mIB.mIndexType == INDEX_16) {
+                reinterpret_cast<uint16_t*>(mData)[i] = (uint16_t)pIndex;
+            }
+            else {
+                reinterpret_cast<uint32_t*>(mData)[i] = pIndex;
+            }
         }
     };
 
@@ -187,35 +237,83 @@ namespace trillek {
 
         virtual void draw() = 0;
 
+        primitive_type_t primitive_type() const {
+            return mType;
+        }
+
+        uint32_t vertex_start() const {
+            return mVertexStart;
+        }
+
+        uint32_t primitive_count() const {
+            return mPrimitiveCount;
+        }
+
+        const std::shared_ptr<vertex_buffer>& get_vertex_buffer() const {
+            return mVertexBuffer;
+        }
+
+        // An indexed mesh draws mIndexCount indices from its index buffer,
+        // starting at index_start().
+        bool indexed() const {
+            return (bool)mIndexBuffer;
+        }
+
+        uint32_t index_start() const {
+            return mIndexStart;
+        }
+
+        const std::shared_ptr<index_buffer>& get_index_buffer() const {
+            return mIndexBuffer;
+        }
+
+        // A batch mesh draws several separate ranges of its vertex buffer
+        // in one call. An ordinary mesh has no ranges.
+        uint32_t range_count() const {
+            return mRangeStarts.size();
+        }
+
+        const uint32_t* range_starts() const {
+            return mRangeStarts.data();
+        }
+
+        const uint32_t* range_primitive_counts() const {
+            return mRangePrimitiveCounts.data();
+        }
+
     protected:
         friend class mesh_builder;
+        friend class indexed_mesh_builder;
+
+        // Lay the ranges out back to back from vertex 0, and size the
+        // mesh to hold them all.
+        void set_ranges(const std::vector<uint32_t>& pPrimitiveCounts);
 
         primitive_type_t mType;
+        uint32_t mPrimitiveCount;
         uint32_t mVertexStart;
         uint32_t mVertexCount;
         uint32_t mIndexStart;
         uint32_t mIndexCount;
-        uint16_t mMinIndex;
 
         std::weak_ptr<graphics_device> mDevice;
         std::shared_ptr<vertex_buffer> mVertexBuffer;
+        std::shared_ptr<index_buffer> mIndexBuffer;
+
+        std::vector<uint32_t> mRangeStarts;
+        std::vector<uint32_t> mRangePrimitiveCounts;
 
         mesh(std::weak_ptr<graphics_device> pDevice)
-            : mDevice(std::move(pDevice))
+            : mIndexStart(0), mIndexCount(0), mDevice(std::move(pDevice))
         {
         }
     };
 
 
-    class mesh_builder {
+    // Writes the attributes of one vertex of a vertex_format through
+    // pointers to each element.
+    class vertex_writer {
     public:
-        mesh_builder(mesh& pMesh)
-                : mMesh(pMesh) {
-            setup();
-        }
-
-        ~mesh_builder();
-
         void position(float_t x, float_t y, float_t z);
         void position(const float_t* pP);
         void position(const point3_t& pP);
@@ -229,13 +327,9 @@ namespace trillek {
         void color(uint8_t r, uint8_t g, uint8_t b);
         void color(uint8_t r, uint8_t g, uint8_t b, uint8_t a);
 
-        void advance();
-
-    private:
-        mesh& mMesh;
-
-        void setup();
-        // void build_indexes();
+    protected:
+        // Point the element pointers into the vertex at pVertex.
+        void setup(const vertex_format& pFormat, uint8_t* pVertex);
 
         uint32_t mVertexSize;
         uint32_t mTextures;
@@ -247,8 +341,116 @@ namespace trillek {
     };
 
 
+    // Writes vertices straight into a mesh's locked vertex buffer.
+    class mesh_builder : public vertex_writer {
+    public:
+        mesh_builder(mesh& pMesh)
+                : mMesh(pMesh) {
+            setup();
+        }
+
+        ~mesh_builder();
+
+        void advance();
+
+    private:
+        mesh& mMesh;
+
+        void setup();
+    };
+
+
+    // Collects vertices in system memory, welding each one onto an
+    // earlier vertex with identical bytes, and builds an indexed mesh from
+    // the result. Every call to advance() emits one index, so the indices
+    // describe primitives of the builder's type exactly as the vertices
+    // would have without welding.
+    //
+    // A PRIM_TRIANGLES builder can also take other kinds of primitive:
+    // vertices between begin() and end() are converted to a triangle
+    // list when end() is called, and polygons (concave or not) are
+    // triangulated.
+    class indexed_mesh_builder : public vertex_writer {
+    public:
+        indexed_mesh_builder(primitive_type_t pType,
+                std::shared_ptr<vertex_format> pFormat);
+
+        // Forget everything added so far, keeping the allocated storage.
+        void reset();
+
+        void advance();
+
+        void begin(primitive_type_t pType);
+
+        void end();
+
+        uint32_t vertex_count() const {
+            return mVertexCount;
+        }
+
+        uint32_t index_count() const {
+            return mIndices.size();
+        }
+
+        const uint8_t* vertex_data() const {
+            return mVertices.data();
+        }
+
+        const uint32_t* index_data() const {
+            return mIndices.data();
+        }
+
+        // The narrowest index type which can address every vertex.
+        index_type_t index_type() const {
+            return mVertexCount <= 0x10000 ? INDEX_16 : INDEX_32;
+        }
+
+        // Reorder a triangle list's triangles for the post-transform
+        // vertex cache and its vertices for fetch locality. build() does
+        // this itself if anything has been added since.
+        const vertex_cache_stats& optimize();
+
+        // The result of the last optimize().
+        const vertex_cache_stats& cache_stats() const {
+            return mCacheStats;
+        }
+
+        std::unique_ptr<mesh> build(graphics_device& pDevice,
+                buffer_lifetime_t pLifetime = BUFFER_STATIC);
+
+    private:
+        primitive_type_t mType;
+        std::shared_ptr<vertex_format> mFormat;
+
+        // The vertex being written, zeroed after each advance() so that
+        // unwritten elements weld consistently.
+        std::vector<uint8_t> mScratch;
+
+        uint32_t mVertexCount;
+        std::vector<uint8_t> mVertices;
+        std::vector<uint32_t> mIndices;
+
+        // Open-addressed hash of vertex bytes to vertex numbers.
+        std::vector<uint32_t> mWeldTable;
+
+        // The primitive between begin() and end().
+        bool mInPrimitive;
+        primitive_type_t mPrimitiveType;
+        uint32_t mPrimitiveStart;
+        uint32_t mPositionOffset;
+        std::vector<point3_t> mOutline;
+        std::vector<uint32_t> mTriangles;
+
+        bool mOptimized;
+        vertex_cache_stats mCacheStats;
+
+        uint32_t weld();
+        void rehash(uint32_t pTableSize);
+    };
+
+
     inline void
-    mesh_builder::position(float_t x, float_t y, float_t z) {
+    vertex_writer::position(float_t x, float_t y, float_t z) {
         float_t* dest = mCurrPosition;
         *dest++ = x;
         *dest++ = y;
@@ -256,19 +458,19 @@ namespace trillek {
     }
 
     inline void
-    mesh_builder::position(const float_t* pP) {
+    vertex_writer::position(const float_t* pP) {
         position(pP[0], pP[1], pP[2]);
     }
 
 
     inline void
-    mesh_builder::position(const point3_t& pP) {
+    vertex_writer::position(const point3_t& pP) {
         position(pP.x, pP.y, pP.z);
     }
 
 
     inline void
-    mesh_builder::normal(float_t x, float_t y, float_t z) {
+    vertex_writer::normal(float_t x, float_t y, float_t z) {
         float_t* dest = mCurrNormal;
         *dest++ = x;
         *dest++ = y;
@@ -277,18 +479,18 @@ namespace trillek {
 
 
     inline void
-    mesh_builder::normal(const float_t* pN) {
+    vertex_writer::normal(const float_t* pN) {
         normal(pN[0], pN[1], pN[2]);
     }
 
 
     inline void
-    mesh_builder::normal(const vector3_t& pN) {
+    vertex_writer::normal(const vector3_t& pN) {
         normal(pN.x, pN.y, pN.z);
     }
 
     inline void
-    mesh_builder::color(float_t r, float_t g, float_t b) {
+    vertex_writer::color(float_t r, float_t g, float_t b) {
         uint8_t* dest = mCurrColor;
         *dest++ = (uint8_t)(r * 0xFF);
         *dest++ = (uint8_t)(g * 0xFF);
@@ -297,7 +499,7 @@ namespace trillek {
     }
 
     inline void
-    mesh_builder::color(float_t r, float_t g, float_t b, float_t a) {
+    vertex_writer::color(float_t r, float_t g, float_t b, float_t a) {
         uint8_t* dest = mCurrColor;
         *dest++ = (uint8_t)(r * 0xFF);
         *dest++ = (uint8_t)(g * 0xFF);
@@ -306,7 +508,7 @@ namespace trillek {
     }
 
     inline void
-    mesh_builder::color(uint8_t r, uint8_t g, uint8_t b) {
+    vertex_writer::color(uint8_t r, uint8_t g, uint8_t b) {
         uint8_t* dest = mCurrColor;
         *dest++ = r;
         *dest++ = g;
@@ -315,7 +517,7 @@ namespace trillek {
     }
 
     inline void
-    mesh_builder::color(uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    vertex_writer::color(uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
         uint8_t* dest = mCurrColor;
         *dest++ = r;
         *dest++ = g;
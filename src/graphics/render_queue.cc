@@ -0,0 +1,183 @@
+#include <render_queue.hh>
+#include <primitive.hh>
+
+namespace trillek {
+
+namespace {
+
+    static constexpr unsigned RADIX_BITS = 8;
+    static constexpr unsigned RADIX_SIZE = 1 << RADIX_BITS;
+    static constexpr unsigned RADIX_PASSES = 64 / RADIX_BITS;
+
+    // Fold an address into pBits bits. The low bits of a heap address are
+    // mostly alignment, so they're shifted out first.
+    inline uint32_t
+    fold_address(const void* pObject, unsigned pBits) {
+        uint64_t a = reinterpret_cast<uintptr_t>(pObject) >> 4;
+        a ^= a >> pBits;
+        a ^= a >> (pBits * 2);
+        return (uint32_t)(a & ((1u << pBits) - 1));
+    }
+
+}
+
+
+render_queue::render_queue()
+{
+}
+
+
+render_queue::~render_queue()
+{
+}
+
+
+void
+render_queue::reset()
+{
+    mItems.clear();
+    mDraws.clear();
+}
+
+
+void
+render_queue::submit(uint32_t pPass,
+        const std::shared_ptr<graphics_state>& pState,
+        const mesh& pMesh, float_t pDepth)
+{
+    const vertex_buffer* vb = pMesh.get_vertex_buffer().get();
+    sort_key_t key = make_sort_key(pPass,
+        fold_address(pState.get(), SORT_KEY_STATE_BITS),
+        fold_address(&vb->format(), SORT_KEY_FORMAT_BITS),
+        fold_address(vb, SORT_KEY_BUFFER_BITS),
+        sort_key_depth(pDepth));
+    submit_keyed(key, pState, pMesh);
+}
+
+
+void
+render_queue::submit_keyed(sort_key_t pKey,
+        const std::shared_ptr<graphics_state>& pState, const mesh& pMesh)
+{
+    item i;
+    i.mKey = pKey;
+    i.mDraw = mDraws.size();
+    mItems.push_back(i);
+
+    draw d;
+    d.mMesh = &pMesh;
+    d.mState = pState;
+    mDraws.push_back(std::move(d));
+}
+
+
+void
+render_queue::append(const render_queue& pQueue)
+{
+    uint32_t base = mDraws.size();
+    mDraws.insert(mDraws.end(), pQueue.mDraws.begin(), pQueue.mDraws.end());
+    for (auto i : pQueue.mItems) {
+        i.mDraw += base;
+        mItems.push_back(i);
+    }
+}
+
+
+// LSD radix sort, a byte at a time. All eight histograms are built in one
+// pass over the keys, and any byte which is the same in every key is
+// skipped; in practice most of the pass and state bytes are.
+void
+render_queue::sort()
+{
+    std::size_t n = mItems.size();
+    if (n < 2) {
+        return;
+    }
+
+    std::vector<std::array<uint32_t, RADIX_SIZE>> counts(RADIX_PASSES);
+    for (auto& c : counts) {
+        c.fill(0);
+    }
+    for (auto& i : mItems) {
+        for (unsigned p = 0; p < RADIX_PASSES; ++p) {
+            ++counts[p][(i.mKey >> (p * RADIX_BITS)) & (RADIX_SIZE - 1)];
+        }
+    }
+
+    mScratch.resize(n);
+    item* src = mItems.data();
+    item* dst = mScratch.data();
+
+    for (unsigned p = 0; p < RADIX_PASSES; ++p) {
+        std::array<uint32_t, RADIX_SIZE>& c = counts[p];
+        unsigned shift = p * RADIX_BITS;
+        if (c[(src[0].mKey >> shift) & (RADIX_SIZE - 1)] == n) {
+            continue;
+        }
+
+        uint32_t offset = 0;
+        for (auto& bucket : c) {
+            uint32_t count = bucket;
+            bucket = offset;
+            offset += count;
+        }
+
+        for (std::size_t i = 0; i < n; ++i) {
+            dst[c[(src[i].mKey >> shift) & (RADIX_SIZE - 1)]++] = src[i];
+        }
+        std::swap(src, dst);
+    }
+
+    if (src != mItems.data()) {
+        mItems.swap(mScratch);
+    }
+}
+
+
+void
+render_queue::record(command_list& pList) const
+{
+    const graphics_state* state = nullptr;
+    const vertex_buffer* vb = nullptr;
+    const index_buffer* ib = nullptr;
+
+    for (auto& i : mItems) {
+        const draw& d = mDraws[i.mDraw];
+        const mesh& m = *d.mMesh;
+
+        bool changed = false;
+        if (d.mState.get() != state) {
+            pList.set_graphics_state(d.mState);
+            state = d.mState.get();
+            changed = true;
+        }
+        if (m.get_vertex_buffer().get() != vb) {
+            pList.set_vertex_buffer(m.get_vertex_buffer());
+            vb = m.get_vertex_buffer().get();
+            changed = true;
+        }
+        // Unindexed draws ignore whatever index buffer is bound.
+        if (m.indexed() && m.get_index_buffer().get() != ib) {
+            pList.set_index_buffer(m.get_index_buffer());
+            ib = m.get_index_buffer().get();
+            changed = true;
+        }
+        if (changed) {
+            pList.update_state();
+        }
+        if (m.indexed()) {
+            pList.draw_indexed_primitive(m.primitive_type(),
+                    ib->index_type(), m.index_start(), m.primitive_count());
+        }
+        else if (m.range_count()) {
+            pList.draw_primitive_ranges(m.primitive_type(), m.range_starts(),
+                    m.range_primitive_counts(), m.range_count());
+        }
+        else {
+            pList.draw_primitive(m.primitive_type(), m.vertex_start(),
+                    m.primitive_count());
+        }
+    }
+}
+
+}
@@ -0,0 +1,108 @@
+#ifndef RENDER_QUEUE_HH_INCLUDED
+#define RENDER_QUEUE_HH_INCLUDED
+
+#include <command_list.hh>
+
+namespace trillek {
+
+    class mesh;
+
+    // Draw order, most significant field first:
+    //
+    //   63..60  pass
+    //   59..48  graphics state
+    //   47..40  vertex format
+    //   39..20  vertex buffer
+    //   19..0   depth
+    //
+    // Sorting on the whole key groups draws by pass, then by whatever is
+    // most expensive to change, and draws front to back within a group.
+    typedef uint64_t sort_key_t;
+
+    static constexpr unsigned SORT_KEY_PASS_BITS = 4;
+    static constexpr unsigned SORT_KEY_STATE_BITS = 12;
+    static constexpr unsigned SORT_KEY_FORMAT_BITS = 8;
+    static constexpr unsigned SORT_KEY_BUFFER_BITS = 20;
+    static constexpr unsigned SORT_KEY_DEPTH_BITS = 20;
+
+    // Maps a non-negative view depth onto SORT_KEY_DEPTH_BITS, keeping
+    // its order. Negative depths sort with zero.
+    inline uint32_t
+    sort_key_depth(float_t pDepth) {
+        float depth = pDepth > 0 ? pDepth : 0;
+        uint32_t bits;
+        std::memcpy(&bits, &depth, sizeof(bits));
+        return bits >> (32 - SORT_KEY_DEPTH_BITS - 1);
+    }
+
+    inline sort_key_t
+    make_sort_key(uint32_t pPass, uint32_t pState, uint32_t pFormat,
+            uint32_t pBuffer, uint32_t pDepth) {
+        sort_key_t key = pPass & ((1u << SORT_KEY_PASS_BITS) - 1);
+        key = (key << SORT_KEY_STATE_BITS)
+            | (pState & ((1u << SORT_KEY_STATE_BITS) - 1));
+        key = (key << SORT_KEY_FORMAT_BITS)
+            | (pFormat & ((1u << SORT_KEY_FORMAT_BITS) - 1));
+        key = (key << SORT_KEY_BUFFER_BITS)
+            | (pBuffer & ((1u << SORT_KEY_BUFFER_BITS) - 1));
+        key = (key << SORT_KEY_DEPTH_BITS)
+            | (pDepth & ((1u << SORT_KEY_DEPTH_BITS) - 1));
+        return key;
+    }
+
+    // Collects a frame's mesh draws, sorts them on their keys, and records
+    // them with only the state changes which the order actually needs.
+    //
+    // The state, format and buffer fields are folded from the objects'
+    // addresses, so two objects can share a field value. That only costs
+    // an extra state change if their draws interleave; record() compares
+    // the objects themselves.
+    class render_queue {
+    public:
+        render_queue();
+
+        ~render_queue();
+
+        void reset();
+
+        void submit(uint32_t pPass,
+                const std::shared_ptr<graphics_state>& pState,
+                const mesh& pMesh, float_t pDepth = 0);
+
+        // Submit with a key the caller built.
+        void submit_keyed(sort_key_t pKey,
+                const std::shared_ptr<graphics_state>& pState,
+                const mesh& pMesh);
+
+        // Add another queue's draws after this one's.
+        void append(const render_queue& pQueue);
+
+        // Stable sort of the draws by key.
+        void sort();
+
+        // Record the draws, in queue order, onto pList.
+        void record(command_list& pList) const;
+
+        uint32_t size() const {
+            return mItems.size();
+        }
+
+    private:
+        struct item {
+            sort_key_t mKey;
+            uint32_t mDraw;
+        };
+
+        struct draw {
+            const mesh* mMesh;
+            std::shared_ptr<graphics_state> mState;
+        };
+
+        std::vector<item> mItems;
+        std::vector<item> mScratch;
+        std::vector<draw> mDraws;
+    };
+
+}
+
+#endif // RENDER_QUEUE_HH_INCLUDED
@@ -34,6 +34,10 @@ namespace trillek {
     public:
         virtual bool swap_buffers() = 0;
 
+        // Attach the window's rendering context to the calling thread, or
+        // detach it so that another thread can take it.
+        virtual void make_context_current(bool pCurrent) = 0;
+
     protected:
 	window_target(std::weak_ptr<window> pWindow);
 
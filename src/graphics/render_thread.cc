@@ -0,0 +1,213 @@
+#include <render_thread.hh>
+#include <stdexcept>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+namespace trillek {
+
+
+void
+frame_packet::reset()
+{
+    mCommands.reset();
+}
+
+
+void
+render_frame_packet(graphics_device& pDevice,
+        const std::shared_ptr<window_target>& pTarget,
+        const frame_packet& pPacket)
+{
+    pDevice.begin_frame();
+    pDevice.set_render_target(pTarget);
+    pDevice.set_viewport(pPacket.mViewport);
+    pDevice.projection_transform() = pPacket.mProjectionXform;
+    pDevice.camera_transform() = pPacket.mCameraXform;
+    pDevice.model_transform() = pPacket.mModelXform;
+    if (pPacket.mState) {
+        pDevice.set_graphics_state(pPacket.mState);
+    }
+    pDevice.update_state();
+    pPacket.mCommands.execute(pDevice);
+    pDevice.end_frame();
+    pTarget->swap_buffers();
+}
+
+
+// The packets form a ring. mWrite is the packet the simulation is filling
+// (or will fill next), mRead the next one to draw, and mQueued counts the
+// packets submitted but not yet finished, including the one being drawn.
+struct render_thread::impl {
+    std::shared_ptr<graphics_device> mDevice;
+    std::shared_ptr<window_target> mTarget;
+
+    unsigned mPacketCount;
+    std::array<frame_packet, MAX_PACKETS> mPackets;
+    unsigned mWrite;
+    unsigned mRead;
+    unsigned mQueued;
+
+    std::mutex mLock;
+    std::condition_variable mPacketReady;
+    std::condition_variable mPacketFree;
+    std::thread mThread;
+    bool mRunning;
+    bool mQuit;
+    std::exception_ptr mError;
+    uint64_t mFramesRendered;
+
+    impl(std::shared_ptr<graphics_device> pDevice,
+            std::shared_ptr<window_target> pTarget, unsigned pPackets)
+        : mDevice(std::move(pDevice)), mTarget(std::move(pTarget)),
+          mPacketCount(pPackets), mWrite(0), mRead(0), mQueued(0),
+          mRunning(false), mQuit(false), mFramesRendered(0)
+    {
+        if (pPackets < 2 || pPackets > MAX_PACKETS) {
+            throw std::logic_error("render_thread: bad packet count");
+        }
+    }
+
+    void run() {
+        try {
+            mTarget->make_context_current(true);
+            for (;;) {
+                frame_packet* packet;
+                {
+                    std::unique_lock<std::mutex> lock(mLock);
+                    mPacketReady.wait(lock, [this]() {
+                        return mQueued > 0 || mQuit;
+                    });
+                    if (mQueued == 0) {
+                        break;
+                    }
+                    packet = &mPackets[mRead];
+                }
+
+                render_frame_packet(*mDevice, mTarget, *packet);
+
+                std::lock_guard<std::mutex> lock(mLock);
+                mRead = (mRead + 1) % mPacketCount;
+                --mQueued;
+                ++mFramesRendered;
+                mPacketFree.notify_one();
+            }
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(mLock);
+            mError = std::current_exception();
+            mPacketFree.notify_one();
+        }
+        mTarget->make_context_current(false);
+    }
+};
+
+
+render_thread::render_thread(std::shared_ptr<graphics_device> pDevice,
+        std::shared_ptr<window_target> pTarget, unsigned pPackets)
+    : mPImpl(new impl(std::move(pDevice), std::move(pTarget), pPackets))
+{
+}
+
+
+render_thread::~render_thread()
+{
+    if (mPImpl->mRunning) {
+        try {
+            stop();
+        }
+        catch (...) {
+        }
+    }
+}
+
+
+void
+render_thread::start()
+{
+    impl& r = *mPImpl;
+    if (r.mRunning) {
+        throw std::logic_error("render_thread::start");
+    }
+    r.mQuit = false;
+    r.mError = std::exception_ptr();
+    r.mTarget->make_context_current(false);
+    r.mThread = std::thread([&r]() { r.run(); });
+    r.mRunning = true;
+}
+
+
+void
+render_thread::stop()
+{
+    impl& r = *mPImpl;
+    if (!r.mRunning) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(r.mLock);
+        r.mQuit = true;
+    }
+    r.mPacketReady.notify_one();
+    r.mThread.join();
+    r.mRunning = false;
+    r.mTarget->make_context_current(true);
+
+    // Anything left behind by an error is dropped.
+    r.mWrite = r.mRead = r.mQueued = 0;
+    if (r.mError) {
+        std::exception_ptr error = r.mError;
+        r.mError = std::exception_ptr();
+        std::rethrow_exception(error);
+    }
+}
+
+
+bool
+render_thread::running() const
+{
+    return mPImpl->mRunning;
+}
+
+
+frame_packet&
+render_thread::begin_packet()
+{
+    impl& r = *mPImpl;
+    std::unique_lock<std::mutex> lock(r.mLock);
+    r.mPacketFree.wait(lock, [&r]() {
+        return r.mQueued < r.mPacketCount || r.mError;
+    });
+    if (r.mError) {
+        lock.unlock();
+        stop();
+    }
+    frame_packet& packet = r.mPackets[r.mWrite];
+    packet.reset();
+    return packet;
+}
+
+
+void
+render_thread::submit_packet()
+{
+    impl& r = *mPImpl;
+    {
+        std::lock_guard<std::mutex> lock(r.mLock);
+        r.mWrite = (r.mWrite + 1) % r.mPacketCount;
+        ++r.mQueued;
+    }
+    r.mPacketReady.notify_one();
+}
+
+
+uint64_t
+render_thread::frames_rendered() const
+{
+    impl& r = *mPImpl;
+    std::lock_guard<std::mutex> lock(r.mLock);
+    return r.mFramesRendered;
+}
+
+
+}
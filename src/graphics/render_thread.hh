@@ -0,0 +1,71 @@
+#ifndef RENDER_THREAD_HH_INCLUDED
+#define RENDER_THREAD_HH_INCLUDED
+
+#include <command_list.hh>
+
+namespace trillek {
+
+    // Everything the renderer needs to draw one frame: the view set-up and
+    // a recorded draw list. The simulation fills these in, and either
+    // renders them itself or hands them to a render_thread.
+    struct frame_packet {
+        recti_t mViewport;
+        matrix4_t mProjectionXform;
+        matrix4_t mCameraXform;
+        matrix4_t mModelXform;
+        std::shared_ptr<graphics_state> mState;
+        command_list mCommands;
+
+        // Clear the draw list, ready for the next frame.
+        void reset();
+    };
+
+    // Draw pPacket on pTarget and present it.
+    void render_frame_packet(graphics_device& pDevice,
+            const std::shared_ptr<window_target>& pTarget,
+            const frame_packet& pPacket);
+
+    // A thread which owns the rendering context and draws frame packets
+    // while the simulation builds the next one. With two packets the
+    // simulation can run one frame ahead of the GPU submission; with three
+    // it can absorb an occasional slow frame on either side.
+    //
+    // Every GL resource a packet refers to must have been created before
+    // start(), or by the render thread itself.
+    class render_thread : private boost::noncopyable {
+    public:
+        static constexpr unsigned MAX_PACKETS = 3;
+
+        render_thread(std::shared_ptr<graphics_device> pDevice,
+                std::shared_ptr<window_target> pTarget,
+                unsigned pPackets = 2);
+
+        ~render_thread();
+
+        // Hands the context over to the render thread. Call from the
+        // thread which currently owns it.
+        void start();
+
+        // Draws any packets still queued, then hands the context back to
+        // the calling thread.
+        void stop();
+
+        bool running() const;
+
+        // Blocks until a packet is free, and returns it reset. Rethrows
+        // anything the render thread has thrown.
+        frame_packet& begin_packet();
+
+        // Queue the packet returned by begin_packet() for drawing.
+        void submit_packet();
+
+        uint64_t frames_rendered() const;
+
+    private:
+        struct impl;
+        std::unique_ptr<impl> mPImpl;
+    };
+
+}
+
+#endif // RENDER_THREAD_HH_INCLUDED
@@ -0,0 +1,104 @@
+#include <static_batch.hh>
+#include <graphics_device.hh>
+
+namespace trillek {
+
+
+static_batcher::static_batcher(graphics_device& pDevice)
+    : mDevice(pDevice)
+{
+}
+
+
+static_batcher::~static_batcher()
+{
+}
+
+
+static_batcher::group&
+static_batcher::find_group(const std::shared_ptr<graphics_state>& pState,
+        primitive_type_t pType, const std::shared_ptr<vertex_format>& pFormat,
+        bool pTriangles)
+{
+    for (auto& candidate : mGroups) {
+        if (candidate.mState == pState && candidate.mType == pType
+                && candidate.mFormat == pFormat
+                && (bool)candidate.mTriangles == pTriangles) {
+            return candidate;
+        }
+    }
+
+    mGroups.push_back(group());
+    group& g = mGroups.back();
+    g.mState = pState;
+    g.mType = pType;
+    g.mFormat = pFormat;
+    if (pTriangles) {
+        g.mTriangles.reset(new indexed_mesh_builder(pType, pFormat));
+    }
+    return g;
+}
+
+
+void
+static_batcher::add(const std::shared_ptr<graphics_state>& pState,
+        primitive_type_t pType, const std::shared_ptr<vertex_format>& pFormat,
+        uint32_t pPrimitiveCount, build_function pBuild)
+{
+    group& g = find_group(pState, pType, pFormat, false);
+
+    piece p;
+    p.mPrimitiveCount = pPrimitiveCount;
+    p.mBuild = std::move(pBuild);
+    g.mPieces.push_back(std::move(p));
+}
+
+
+void
+static_batcher::add_triangles(const std::shared_ptr<graphics_state>& pState,
+        const std::shared_ptr<vertex_format>& pFormat,
+        const triangles_function& pBuild)
+{
+    pBuild(*find_group(pState, PRIM_TRIANGLES, pFormat, true).mTriangles);
+}
+
+
+std::vector<static_batch>
+static_batcher::build(buffer_lifetime_t pLifetime)
+{
+    std::vector<static_batch> batches;
+    batches.reserve(mGroups.size());
+
+    for (auto& g : mGroups) {
+        if (g.mTriangles) {
+            static_batch batch;
+            batch.mState = g.mState;
+            batch.mMesh = g.mTriangles->build(mDevice, pLifetime);
+            batches.push_back(std::move(batch));
+            continue;
+        }
+
+        std::vector<uint32_t> counts;
+        counts.reserve(g.mPieces.size());
+        for (auto& p : g.mPieces) {
+            counts.push_back(p.mPrimitiveCount);
+        }
+
+        static_batch batch;
+        batch.mState = g.mState;
+        batch.mMesh = mDevice.make_batch_mesh(g.mType, g.mFormat, counts,
+                pLifetime);
+        {
+            mesh_builder builder(*batch.mMesh);
+            for (auto& p : g.mPieces) {
+                p.mBuild(builder);
+            }
+        }
+        batches.push_back(std::move(batch));
+    }
+
+    mGroups.clear();
+    return batches;
+}
+
+}
@@ -0,0 +1,82 @@
+#ifndef STATIC_BATCH_HH_INCLUDED
+#define STATIC_BATCH_HH_INCLUDED
+
+#include <primitive.hh>
+#include <functional>
+
+namespace trillek {
+
+    class graphics_state;
+
+    // One draw's worth of merged static geometry.
+    struct static_batch {
+        std::shared_ptr<graphics_state> mState;
+        std::unique_ptr<mesh> mMesh;
+    };
+
+    // Merges many small pieces of static geometry into as few meshes as
+    // possible. Pieces which share a graphics state, vertex format and
+    // primitive type go into one vertex buffer, and are drawn with one
+    // call over a table of ranges.
+    //
+    // Triangle pieces, which include polygons, strips and fans converted
+    // to triangles as they are added, go into one welded, indexed
+    // triangle list for each state and vertex format.
+    class static_batcher : private boost::noncopyable {
+    public:
+        // Writes one piece's vertices. It must write exactly
+        // primitive_vertex_count(type, primitive count) of them.
+        typedef std::function<void (mesh_builder& pBuilder)> build_function;
+
+        // Writes one piece's vertices as triangles, or as other kinds of
+        // primitive between indexed_mesh_builder::begin() and end().
+        typedef std::function<void (indexed_mesh_builder& pBuilder)>
+            triangles_function;
+
+        static_batcher(graphics_device& pDevice);
+
+        ~static_batcher();
+
+        void add(const std::shared_ptr<graphics_state>& pState,
+                primitive_type_t pType,
+                const std::shared_ptr<vertex_format>& pFormat,
+                uint32_t pPrimitiveCount, build_function pBuild);
+
+        // pBuild is called straight away.
+        void add_triangles(const std::shared_ptr<graphics_state>& pState,
+                const std::shared_ptr<vertex_format>& pFormat,
+                const triangles_function& pBuild);
+
+        // Build every batch, in the order its first piece was added, and
+        // forget the pieces.
+        std::vector<static_batch> build(
+                buffer_lifetime_t pLifetime = BUFFER_STATIC);
+
+    private:
+        struct piece {
+            uint32_t mPrimitiveCount;
+            build_function mBuild;
+        };
+
+        struct group {
+            std::shared_ptr<graphics_state> mState;
+            primitive_type_t mType;
+            std::shared_ptr<vertex_format> mFormat;
+            std::vector<piece> mPieces;
+
+            // Set for triangle groups, which have no pieces.
+            std::unique_ptr<indexed_mesh_builder> mTriangles;
+        };
+
+        graphics_device& mDevice;
+        std::vector<group> mGroups;
+
+        group& find_group(const std::shared_ptr<graphics_state>& pState,
+                primitive_type_t pType,
+                const std::shared_ptr<vertex_format>& pFormat,
+                bool pTriangles);
+    };
+
+}
+
+#endif // STATIC_BATCH_HH_INCLUDED
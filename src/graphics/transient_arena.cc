@@ -0,0 +1,105 @@
+#include <transient_arena.hh>
+#include <primitive.hh>
+#include <stdexcept>
+
+namespace trillek {
+
+
+transient_arena::transient_arena(uint32_t pRegionBytes, uint32_t pRegions)
+    : mRegionBytes(pRegionBytes), mRegions(pRegions),
+      mRegion(0), mCursor(0), mRegionEnd(pRegionBytes),
+      mMapped(nullptr), mMapOffset(0)
+{
+    if (pRegionBytes == 0 || pRegions == 0) {
+        throw std::logic_error("transient_arena");
+    }
+}
+
+
+transient_arena::~transient_arena()
+{
+}
+
+
+void*
+transient_arena::allocate(uint32_t pBytes, uint32_t pAlign, uint32_t* pOffset)
+{
+    uint32_t offset = reserve(pBytes, pAlign);
+
+    // Map everything left in the region at once, so that allocations
+    // between draws share one mapping.
+    if (!mMapped) {
+        mMapped = map_range(offset, mRegionEnd - offset);
+        mMapOffset = offset;
+    }
+
+    *pOffset = offset;
+    return mMapped + (offset - mMapOffset);
+}
+
+
+uint32_t
+transient_arena::reserve(uint32_t pBytes, uint32_t pAlign)
+{
+    uint32_t offset = (mCursor + pAlign - 1) / pAlign * pAlign;
+    if (offset + pBytes > mRegionEnd || offset < mCursor) {
+        throw std::runtime_error("transient_arena: frame region exhausted");
+    }
+    mCursor = offset + pBytes;
+    return offset;
+}
+
+
+std::shared_ptr<vertex_buffer>
+transient_arena::vertex_view(const std::shared_ptr<vertex_format>& pFormat)
+{
+    for (auto& v : mVertexViews) {
+        if (v.first == pFormat.get()) {
+            return v.second;
+        }
+    }
+    mVertexViews.push_back(std::make_pair(pFormat.get(),
+        make_vertex_view(pFormat)));
+    return mVertexViews.back().second;
+}
+
+
+std::shared_ptr<index_buffer>
+transient_arena::index_view(index_type_t pType)
+{
+    if (!mIndexViews[pType]) {
+        mIndexViews[pType] = make_index_view(pType);
+    }
+    return mIndexViews[pType];
+}
+
+
+void
+transient_arena::begin_frame()
+{
+    unmap();
+    mRegion = (mRegion + 1) % mRegions;
+    wait_region(mRegion);
+    mCursor = mRegion * mRegionBytes;
+    mRegionEnd = mCursor + mRegionBytes;
+}
+
+
+void
+transient_arena::end_frame()
+{
+    unmap();
+    fence_region(mRegion);
+}
+
+
+void
+transient_arena::unmap()
+{
+    if (mMapped) {
+        unmap_range();
+        mMapped = nullptr;
+    }
+}
+
+}
@@ -0,0 +1,96 @@
+#ifndef TRANSIENT_ARENA_HH_INCLUDED
+#define TRANSIENT_ARENA_HH_INCLUDED
+
+#include <graphics_constants.hh>
+
+namespace trillek {
+
+    class vertex_format;
+    class vertex_buffer;
+    class index_buffer;
+
+    // One large buffer, split into a region per frame in flight, which
+    // hands out vertex and index space that only has to live until the
+    // end of the frame. Allocation just bumps a cursor through the current
+    // region. A region is fenced when its frame ends, and only waited on
+    // when it comes round again, by which time the GPU has normally long
+    // finished with it.
+    //
+    // The space handed out is drawn through views: vertex and index
+    // buffers which share the arena's storage, one per vertex format or
+    // index type.
+    class transient_arena : private boost::noncopyable {
+    public:
+        virtual ~transient_arena();
+
+        uint32_t region_bytes() const {
+            return mRegionBytes;
+        }
+
+        uint32_t regions() const {
+            return mRegions;
+        }
+
+        // Bytes handed out from the current region so far.
+        uint32_t used_bytes() const {
+            return mCursor - mRegion * mRegionBytes;
+        }
+
+        // pBytes bytes at an offset into the arena which is a multiple of
+        // pAlign, written to *pOffset. The pointer stays valid until the
+        // device next draws. Throws if the frame's region is exhausted.
+        void* allocate(uint32_t pBytes, uint32_t pAlign, uint32_t* pOffset);
+
+        // Like allocate(), but without mapping anything, for callers which
+        // upload the space themselves. Returns the offset.
+        uint32_t reserve(uint32_t pBytes, uint32_t pAlign);
+
+        std::shared_ptr<vertex_buffer>
+        vertex_view(const std::shared_ptr<vertex_format>& pFormat);
+
+        std::shared_ptr<index_buffer> index_view(index_type_t pType);
+
+        // Called by the device around each frame, and before it draws.
+        void begin_frame();
+        void end_frame();
+        void unmap();
+
+    protected:
+        transient_arena(uint32_t pRegionBytes, uint32_t pRegions);
+
+        // Block until the GPU has finished with the region's last frame.
+        virtual void wait_region(uint32_t pRegion) = 0;
+
+        // Mark the end of the commands which read the region.
+        virtual void fence_region(uint32_t pRegion) = 0;
+
+        // Map [pOffset, pOffset + pBytes) for writing without waiting on
+        // the GPU; the fences make that safe.
+        virtual uint8_t* map_range(uint32_t pOffset, uint32_t pBytes) = 0;
+        virtual void unmap_range() = 0;
+
+        virtual std::shared_ptr<vertex_buffer>
+        make_vertex_view(std::shared_ptr<vertex_format> pFormat) = 0;
+
+        virtual std::shared_ptr<index_buffer>
+        make_index_view(index_type_t pType) = 0;
+
+        uint32_t mRegionBytes;
+        uint32_t mRegions;
+
+    private:
+        uint32_t mRegion;
+        uint32_t mCursor;
+        uint32_t mRegionEnd;
+
+        uint8_t* mMapped;
+        uint32_t mMapOffset;
+
+        std::vector<std::pair<vertex_format*, std::shared_ptr<vertex_buffer>>>
+            mVertexViews;
+        std::shared_ptr<index_buffer> mIndexViews[INDEX_LAST];
+    };
+
+}
+
+#endif // TRANSIENT_ARENA_HH_INCLUDED
@@ -0,0 +1,194 @@
+#include <triangulate.hh>
+#include <cmath>
+
+namespace trillek {
+
+namespace {
+
+    struct point2_t {
+        float_t u, v;
+    };
+
+    // Twice the signed area of (pA, pB, pC); positive when they turn
+    // counter-clockwise.
+    inline float_t
+    turn(const point2_t& pA, const point2_t& pB, const point2_t& pC) {
+        return (pB.u - pA.u) * (pC.v - pA.v) - (pB.v - pA.v) * (pC.u - pA.u);
+    }
+
+    inline bool
+    inside_triangle(const point2_t& pP, const point2_t& pA,
+            const point2_t& pB, const point2_t& pC) {
+        return turn(pA, pB, pP) >= 0 && turn(pB, pC, pP) >= 0
+            && turn(pC, pA, pP) >= 0;
+    }
+
+    inline void
+    emit(std::vector<uint32_t>& pOut, uint32_t pA, uint32_t pB, uint32_t pC) {
+        pOut.push_back(pA);
+        pOut.push_back(pB);
+        pOut.push_back(pC);
+    }
+
+}
+
+
+uint32_t
+triangulate_polygon(const point3_t* pPoints, uint32_t pCount,
+        std::vector<uint32_t>& pTriangles)
+{
+    if (pCount < 3) {
+        return 0;
+    }
+    std::size_t first = pTriangles.size();
+    pTriangles.reserve(first + (pCount - 2) * 3);
+
+    if (pCount == 3) {
+        emit(pTriangles, 0, 1, 2);
+        return 1;
+    }
+
+    // Newell's method gives the polygon's normal whatever its shape.
+    float_t nx = 0, ny = 0, nz = 0;
+    for (uint32_t i = 0, j = pCount - 1; i < pCount; j = i++) {
+        const point3_t& a = pPoints[j];
+        const point3_t& b = pPoints[i];
+        nx += (a.y - b.y) * (a.z + b.z);
+        ny += (a.z - b.z) * (a.x + b.x);
+        nz += (a.x - b.x) * (a.y + b.y);
+    }
+
+    // Project onto the plane the polygon is most nearly parallel to,
+    // choosing the axes so that the polygon comes out counter-clockwise.
+    float_t ax = std::fabs(nx), ay = std::fabs(ny), az = std::fabs(nz);
+    std::vector<point2_t> flat(pCount);
+    for (uint32_t i = 0; i < pCount; ++i) {
+        const point3_t& p = pPoints[i];
+        if (az >= ax && az >= ay) {
+            flat[i].u = p.x;
+            flat[i].v = nz >= 0 ? p.y : -p.y;
+        }
+        else if (ax >= ay) {
+            flat[i].u = p.y;
+            flat[i].v = nx >= 0 ? p.z : -p.z;
+        }
+        else {
+            flat[i].u = p.z;
+            flat[i].v = ny >= 0 ? p.x : -p.x;
+        }
+    }
+
+    std::vector<uint32_t> prev(pCount), next(pCount);
+    for (uint32_t i = 0; i < pCount; ++i) {
+        prev[i] = i == 0 ? pCount - 1 : i - 1;
+        next[i] = i + 1 == pCount ? 0 : i + 1;
+    }
+
+    uint32_t remaining = pCount;
+    uint32_t v = 0;
+    uint32_t sinceLastClip = 0;
+    while (remaining > 3) {
+        uint32_t p = prev[v];
+        uint32_t n = next[v];
+        float_t t = turn(flat[p], flat[v], flat[n]);
+
+        bool clip = false;
+        bool keep = true;
+        if (t == 0) {
+            // Collinear: dropping v doesn't change the outline.
+            clip = true;
+            keep = false;
+        }
+        else if (t > 0) {
+            clip = true;
+            for (uint32_t r = next[n]; r != p; r = next[r]) {
+                if (inside_triangle(flat[r], flat[p], flat[v], flat[n])) {
+                    clip = false;
+                    break;
+                }
+            }
+        }
+
+        // Nothing is an ear, so the outline crosses itself. Clip anyway
+        // so that we terminate.
+        if (!clip && sinceLastClip > remaining) {
+            clip = true;
+        }
+
+        if (clip) {
+            if (keep) {
+                emit(pTriangles, p, v, n);
+            }
+            next[p] = n;
+            prev[n] = p;
+            --remaining;
+            sinceLastClip = 0;
+            v = p;
+        }
+        else {
+            ++sinceLastClip;
+            v = n;
+        }
+    }
+
+    uint32_t p = prev[v];
+    uint32_t n = next[v];
+    if (turn(flat[p], flat[v], flat[n]) != 0) {
+        emit(pTriangles, p, v, n);
+    }
+    return (pTriangles.size() - first) / 3;
+}
+
+
+uint32_t
+triangle_list_indices(primitive_type_t pType, uint32_t pVertexCount,
+        std::vector<uint32_t>& pTriangles)
+{
+    std::size_t first = pTriangles.size();
+
+    switch (pType) {
+    case PRIM_TRIANGLES:
+        for (uint32_t i = 0; i + 2 < pVertexCount; i += 3) {
+            emit(pTriangles, i, i + 1, i + 2);
+        }
+        break;
+
+    case PRIM_TRIANGLE_STRIP:
+        for (uint32_t i = 0; i + 2 < pVertexCount; ++i) {
+            if (i & 1) {
+                emit(pTriangles, i + 1, i, i + 2);
+            }
+            else {
+                emit(pTriangles, i, i + 1, i + 2);
+            }
+        }
+        break;
+
+    case PRIM_TRIANGLE_FAN:
+        for (uint32_t i = 1; i + 1 < pVertexCount; ++i) {
+            emit(pTriangles, 0, i, i + 1);
+        }
+        break;
+
+    case PRIM_QUADS:
+        for (uint32_t i = 0; i + 3 < pVertexCount; i += 4) {
+            emit(pTriangles, i, i + 1, i + 2);
+            emit(pTriangles, i, i + 2, i + 3);
+        }
+        break;
+
+    case PRIM_QUAD_STRIP:
+        for (uint32_t i = 0; i + 3 < pVertexCount; i += 2) {
+            emit(pTriangles, i, i + 1, i + 3);
+            emit(pTriangles, i, i + 3, i + 2);
+        }
+        break;
+
+    default:
+        throw std::logic_error("triangle_list_indices");
+    }
+
+    return (pTriangles.size() - first) / 3;
+}
+
+}
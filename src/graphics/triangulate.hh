@@ -0,0 +1,26 @@
+#ifndef TRIANGULATE_HH_INCLUDED
+#define TRIANGULATE_HH_INCLUDED
+
+#include <graphics_constants.hh>
+#include <vector3.hh>
+
+namespace trillek {
+
+    // Split the simple polygon pPoints[0..pCount), which may be concave,
+    // into triangles by ear clipping. Each triangle is appended to
+    // pTriangles as three vertex numbers, wound the same way as the
+    // polygon. Collinear vertices produce no triangles, and a polygon
+    // which isn't simple still produces a fan-like covering rather than
+    // failing. Returns the number of triangles appended.
+    uint32_t triangulate_polygon(const point3_t* pPoints, uint32_t pCount,
+            std::vector<uint32_t>& pTriangles);
+
+    // Append the triangle list equivalent of pVertexCount vertices drawn
+    // as pType, as triples of vertex numbers. Strips keep their winding.
+    // PRIM_POLYGON needs the positions, so use triangulate_polygon().
+    uint32_t triangle_list_indices(primitive_type_t pType,
+            uint32_t pVertexCount, std::vector<uint32_t>& pTriangles);
+
+}
+
+#endif // TRIANGULATE_HH_INCLUDED
@@ -0,0 +1,330 @@
+#include <event_log.hh>
+#include <stdexcept>
+
+namespace trillek {
+
+namespace {
+
+    static const char sLogMagic[8] = { 'T','R','K','E','V','L','G','1' };
+
+    enum {
+        RECORD_FRAME = 0,
+        RECORD_EVENT
+    };
+
+    template<typename T>
+    inline void
+    write_raw(std::ostream& pOut, T pValue) {
+        pOut.write(reinterpret_cast<const char*>(&pValue), sizeof(T));
+    }
+
+    template<typename T>
+    inline T
+    read_raw(std::istream& pIn) {
+        T value;
+        pIn.read(reinterpret_cast<char*>(&value), sizeof(T));
+        return value;
+    }
+
+}
+
+
+system_event_t
+event_log_record_t::make_event() const
+{
+    system_event_t ev(mType, mSubtype, mData);
+    if (mDataTag != EVDATA_NONE) {
+        ev.set_raw_extra_data(mDataTag, mPayload.data(), mPayload.size());
+    }
+    return ev;
+}
+
+
+void
+read_event_log(const std::string& pPath,
+        std::vector<event_log_record_t>& pRecords)
+{
+    std::ifstream in(pPath, std::ios::binary);
+    char magic[sizeof(sLogMagic)];
+    if (!in.read(magic, sizeof(magic))
+            || std::memcmp(magic, sLogMagic, sizeof(magic))) {
+        throw std::runtime_error("read_event_log: not an event log");
+    }
+
+    uint64_t time = 0;
+    for (;;) {
+        uint32_t delta = read_raw<uint32_t>(in);
+        uint8_t kind = read_raw<uint8_t>(in);
+        if (!in) {
+            break;
+        }
+
+        event_log_record_t rec;
+        time += delta;
+        rec.mTime = time;
+        rec.mFrameMark = kind == RECORD_FRAME;
+        rec.mType = EV_NONE;
+        rec.mSubtype = 0;
+        rec.mData = 0;
+        rec.mDataTag = EVDATA_NONE;
+        if (kind == RECORD_EVENT) {
+            rec.mType = (system_event_type_t)read_raw<uint8_t>(in);
+            rec.mSubtype = read_raw<uint16_t>(in);
+            rec.mData = read_raw<int32_t>(in);
+            rec.mDataTag = (system_event_data_tag_t)read_raw<uint8_t>(in);
+            rec.mPayload.resize(read_raw<uint16_t>(in));
+            in.read(reinterpret_cast<char*>(rec.mPayload.data()),
+                    rec.mPayload.size());
+            if (!in) {
+                throw std::runtime_error("read_event_log: truncated record");
+            }
+        }
+        else if (kind != RECORD_FRAME) {
+            throw std::runtime_error("read_event_log: bad record");
+        }
+        pRecords.push_back(std::move(rec));
+    }
+}
+
+
+system_event_recorder::system_event_recorder(system_event_queue& pQueue,
+        std::string pPath)
+    : mQueue(pQueue), mPath(std::move(pPath))
+{
+}
+
+
+system_event_recorder::~system_event_recorder()
+{
+}
+
+
+void
+system_event_recorder::pre_init()
+{
+    mLog.open(mPath, std::ios::binary | std::ios::trunc);
+    if (!mLog) {
+        throw std::runtime_error("system_event_recorder: cannot open log");
+    }
+    mLog.write(sLogMagic, sizeof(sLogMagic));
+    mLastRecord = std::chrono::steady_clock::now();
+    mQueue.pre_init();
+}
+
+
+void
+system_event_recorder::init(const subsystem_manager& pMgr)
+{
+    mQueue.init(pMgr);
+}
+
+
+void
+system_event_recorder::post_init()
+{
+    mQueue.post_init();
+}
+
+
+void
+system_event_recorder::pre_shutdown()
+{
+    mQueue.pre_shutdown();
+    std::lock_guard<std::mutex> lock(mLock);
+    mLog.close();
+}
+
+
+void
+system_event_recorder::shutdown()
+{
+    mQueue.shutdown();
+}
+
+
+void
+system_event_recorder::configure(uint32_t pCapacity,
+        system_event_overflow_t pOverflow)
+{
+    mQueue.configure(pCapacity, pOverflow);
+}
+
+
+void
+system_event_recorder::get_stats(system_event_queue_stats& pStats) const
+{
+    mQueue.get_stats(pStats);
+}
+
+
+void
+system_event_recorder::clear()
+{
+    mQueue.clear();
+}
+
+
+// Called with mLock held.
+void
+system_event_recorder::write_header(uint8_t pKind)
+{
+    auto now = std::chrono::steady_clock::now();
+    uint32_t delta = std::chrono::duration_cast<std::chrono::microseconds>(
+        now - mLastRecord
+    ).count();
+    mLastRecord = now;
+    write_raw<uint32_t>(mLog, delta);
+    write_raw<uint8_t>(mLog, pKind);
+}
+
+
+void
+system_event_recorder::push(system_event_t pEvent)
+{
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        if (mLog.is_open()) {
+            write_header(RECORD_EVENT);
+            write_raw<uint8_t>(mLog, pEvent.mType);
+            write_raw<uint16_t>(mLog, pEvent.mSubtype);
+            write_raw<int32_t>(mLog, pEvent.mData);
+            write_raw<uint8_t>(mLog, pEvent.extra_data_tag());
+            write_raw<uint16_t>(mLog, pEvent.extra_data_size());
+            if (pEvent.has_extra_data()) {
+                mLog.write(
+                    reinterpret_cast<const char*>(pEvent.raw_extra_data()),
+                    pEvent.extra_data_size()
+                );
+            }
+        }
+    }
+    mQueue.push(std::move(pEvent));
+}
+
+
+bool
+system_event_recorder::more_events() const
+{
+    return mQueue.more_events();
+}
+
+
+system_event_t
+system_event_recorder::get()
+{
+    return mQueue.get();
+}
+
+
+void
+system_event_recorder::mark_frame()
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    if (mLog.is_open()) {
+        write_header(RECORD_FRAME);
+    }
+}
+
+
+platform_subsystem_replay::platform_subsystem_replay(
+        platform_subsystem& pPlatform, std::string pPath, speed_t pSpeed)
+    : mPlatform(pPlatform), mPath(std::move(pPath)), mSpeed(pSpeed),
+      mQueue(nullptr), mNext(0), mStarted(false)
+{
+}
+
+
+std::vector<interface_key_t>
+platform_subsystem_replay::dependencies() const
+{
+    std::vector<interface_key_t> deps = mPlatform.dependencies();
+    interface_key_t queueKey = system_event_queue::s_interface;
+    deps.push_back(queueKey);
+    return deps;
+}
+
+
+bool
+platform_subsystem_replay::main_thread_only() const
+{
+    return mPlatform.main_thread_only();
+}
+
+
+void
+platform_subsystem_replay::pre_init()
+{
+    read_event_log(mPath, mRecords);
+    mPlatform.pre_init();
+}
+
+
+void
+platform_subsystem_replay::init(const subsystem_manager& pMgr)
+{
+    mQueue = &pMgr.lookup<system_event_queue>();
+    mPlatform.init(pMgr);
+}
+
+
+void
+platform_subsystem_replay::post_init()
+{
+    mPlatform.post_init();
+}
+
+
+void
+platform_subsystem_replay::pre_shutdown()
+{
+    mPlatform.pre_shutdown();
+}
+
+
+void
+platform_subsystem_replay::shutdown()
+{
+    mPlatform.shutdown();
+}
+
+
+window_manager&
+platform_subsystem_replay::get_window_manager()
+{
+    return mPlatform.get_window_manager();
+}
+
+
+void
+platform_subsystem_replay::frame()
+{
+    mPlatform.frame();
+
+    if (!mStarted) {
+        mStart = std::chrono::steady_clock::now();
+        mStarted = true;
+    }
+
+    if (mSpeed == REPLAY_MAX_SPEED) {
+        while (mNext < mRecords.size()) {
+            const event_log_record_t& rec = mRecords[mNext++];
+            if (rec.mFrameMark) {
+                break;
+            }
+            mQueue->push(rec.make_event());
+        }
+        return;
+    }
+
+    uint64_t elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - mStart
+    ).count();
+    while (mNext < mRecords.size() && mRecords[mNext].mTime <= elapsed) {
+        const event_log_record_t& rec = mRecords[mNext++];
+        if (!rec.mFrameMark) {
+            mQueue->push(rec.make_event());
+        }
+    }
+}
+
+}
@@ -0,0 +1,133 @@
+#ifndef EVENT_LOG_HH_INCLUDED
+#define EVENT_LOG_HH_INCLUDED
+
+#include "system_event.hh"
+#include "platform_subsystem.hh"
+
+#include <string>
+#include <fstream>
+#include <mutex>
+#include <chrono>
+
+namespace trillek {
+
+    // Binary input logs, for repeatable benchmark runs.
+    //
+    // A log is the 8-byte magic "TRKEVLG1" followed by records in host
+    // byte order. Each record starts with the time in microseconds since
+    // the previous record (u32) and a kind byte. Frame marks have nothing
+    // else; events follow with type (u8), subtype (u16), data (i32),
+    // payload tag (u8), payload size (u16) and the payload bytes.
+
+    struct event_log_record_t {
+        uint64_t mTime;     // Microseconds since the start of the log.
+        bool mFrameMark;
+        system_event_type_t mType;
+        unsigned mSubtype;
+        int mData;
+        system_event_data_tag_t mDataTag;
+        std::vector<uint8_t> mPayload;
+
+        system_event_t make_event() const;
+    };
+
+    void read_event_log(const std::string& pPath,
+            std::vector<event_log_record_t>& pRecords);
+
+
+    // Stands in for the system event queue, writing every pushed event to
+    // a log before passing it on. Load it under system_event_queue's key
+    // in place of the queue it wraps. mark_frame() should be called once
+    // per client frame, after the platform has dispatched its events.
+    class system_event_recorder : public system_event_queue {
+    public:
+        system_event_recorder(system_event_queue& pQueue, std::string pPath);
+
+        ~system_event_recorder();
+
+        interface_key_t implements() const {
+            return system_event_queue::s_interface;
+        }
+
+        void pre_init();
+        void init(const subsystem_manager& pMgr);
+        void post_init();
+        void pre_shutdown();
+        void shutdown();
+
+        void configure(uint32_t pCapacity,
+                system_event_overflow_t pOverflow);
+        void get_stats(system_event_queue_stats& pStats) const;
+
+        void clear();
+        void push(system_event_t pEvent);
+        bool more_events() const;
+        system_event_t get();
+
+        void mark_frame();
+
+    private:
+        void write_header(uint8_t pKind);
+
+        system_event_queue& mQueue;
+        std::string mPath;
+        std::ofstream mLog;
+        std::mutex mLock;
+        std::chrono::steady_clock::time_point mLastRecord;
+    };
+
+
+    // Stands in for a platform subsystem, forwarding everything to it but
+    // feeding a recorded log into the event queue each frame. At recorded
+    // speed, events are posted once as much time has passed as when they
+    // were captured; at maximum speed, each frame() posts exactly one
+    // recorded frame's worth of events. Pair it with the headless platform
+    // for unattended runs.
+    class platform_subsystem_replay : public platform_subsystem {
+    public:
+        enum speed_t {
+            REPLAY_RECORDED_SPEED,
+            REPLAY_MAX_SPEED
+        };
+
+        platform_subsystem_replay(platform_subsystem& pPlatform,
+                std::string pPath, speed_t pSpeed);
+
+        interface_key_t implements() const {
+            return platform_subsystem::s_interface;
+        }
+
+        std::vector<interface_key_t> dependencies() const;
+
+        bool main_thread_only() const;
+
+        void pre_init();
+        void init(const subsystem_manager& pMgr);
+        void post_init();
+        void pre_shutdown();
+        void shutdown();
+
+        window_manager& get_window_manager();
+
+        void frame();
+
+        // True once every recorded event has been posted.
+        bool finished() const {
+            return mNext >= mRecords.size();
+        }
+
+    private:
+        platform_subsystem& mPlatform;
+        std::string mPath;
+        speed_t mSpeed;
+        system_event_queue* mQueue;
+
+        std::vector<event_log_record_t> mRecords;
+        size_t mNext;
+        bool mStarted;
+        std::chrono::steady_clock::time_point mStart;
+    };
+
+}
+
+#endif // EVENT_LOG_HH_INCLUDED
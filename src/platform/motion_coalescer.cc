@@ -0,0 +1,72 @@
+#include <motion_coalescer.hh>
+#include <chrono>
+
+namespace trillek {
+
+namespace {
+
+    inline uint64_t
+    timestamp_us() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()
+        ).count();
+    }
+
+}
+
+
+motion_coalescer::motion_coalescer()
+{
+    for (auto& a : mAxes) {
+        a.mTotal = 0;
+        a.mSamples = 0;
+        a.mFirstTime = a.mLastTime = 0;
+    }
+}
+
+
+void
+motion_coalescer::add(unsigned pAxis, int pDelta)
+{
+    axis_t& a = mAxes[pAxis];
+    uint64_t now = timestamp_us();
+    if (!a.mSamples) {
+        a.mFirstTime = now;
+    }
+    a.mLastTime = now;
+    a.mTotal += pDelta;
+    ++a.mSamples;
+}
+
+
+bool
+motion_coalescer::pending() const
+{
+    for (auto& a : mAxes) {
+        if (a.mSamples) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+void
+motion_coalescer::flush(system_event_queue& pQueue)
+{
+    for (unsigned i = 0; i < EV_M_LAST; ++i) {
+        axis_t& a = mAxes[i];
+        if (!a.mSamples) {
+            continue;
+        }
+        mouse_motion_data data;
+        data.mSamples = a.mSamples;
+        data.mFirstTime = a.mFirstTime;
+        data.mLastTime = a.mLastTime;
+        pQueue.push(system_event_t(EV_MOUSE, i, a.mTotal, data));
+        a.mTotal = 0;
+        a.mSamples = 0;
+    }
+}
+
+}
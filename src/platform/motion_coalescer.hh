@@ -0,0 +1,40 @@
+#ifndef MOTION_COALESCER_HH_INCLUDED
+#define MOTION_COALESCER_HH_INCLUDED
+
+#include "system_event.hh"
+
+namespace trillek {
+
+    // Accumulates relative mouse motion and wheel deltas so that a window
+    // can post one EV_MOUSE event per axis per frame instead of one per
+    // hardware sample. Each merged event carries a mouse_motion_data with
+    // the sample count and the times of the first and last samples. An
+    // axis whose samples cancel out still gets its event, with a zero
+    // delta, so that nothing is lost to consumers which count samples.
+    //
+    // flush() must be called before posting any other kind of event, so
+    // that motion stays correctly ordered with respect to key presses.
+    class motion_coalescer {
+    public:
+        motion_coalescer();
+
+        void add(unsigned pAxis, int pDelta);
+
+        bool pending() const;
+
+        void flush(system_event_queue& pQueue);
+
+    private:
+        struct axis_t {
+            int mTotal;
+            uint32_t mSamples;
+            uint64_t mFirstTime;
+            uint64_t mLastTime;
+        };
+
+        axis_t mAxes[EV_M_LAST];
+    };
+
+}
+
+#endif // MOTION_COALESCER_HH_INCLUDED
@@ -0,0 +1,135 @@
+#include <platform_null.hh>
+#include <window_manager_null.hh>
+#include <graphics_device_null.hh>
+#include <graphics_adapter.hh>
+#include <graphics_subsystem.hh>
+
+namespace trillek {
+
+    namespace {
+        static const char* sAdapterName = "Headless Adapter";
+
+        static constexpr uint32_t s_width = 800;
+        static constexpr uint32_t s_height = 600;
+
+        std::shared_ptr<graphics_device>
+        null_device_factory_default() {
+            return std::make_shared<graphics_device_null>();
+        }
+    }
+
+
+window_manager&
+platform_subsystem_null::get_window_manager() {
+    return *mWindowManager;
+}
+
+std::vector<interface_key_t>
+platform_subsystem_null::dependencies() const {
+    return std::vector<interface_key_t> {
+        graphics_subsystem::s_interface,
+        system_event_queue::s_interface
+    };
+}
+
+platform_subsystem_null::platform_subsystem_null() {
+    mWidth = s_width;
+    mHeight = s_height;
+
+    mConfig.mMajorVersion = 3;
+    mConfig.mMinorVersion = 0;
+    mConfig.mDepthBits = 32;
+    mConfig.mStencilBits = 8;
+    mConfig.mAntialiasingLevel = 0;
+
+    mDeviceFactory = null_device_factory_default;
+}
+
+platform_subsystem_null::~platform_subsystem_null() {
+}
+
+void
+platform_subsystem_null::set_window_size(uint32_t pWidth, uint32_t pHeight) {
+    mWidth = pWidth;
+    mHeight = pHeight;
+}
+
+void
+platform_subsystem_null::set_graphics_config(const graphics_config_t& pConfig) {
+    mConfig = pConfig;
+}
+
+void
+platform_subsystem_null::set_event_source(synthetic_event_source pSource) {
+    mEventSource = std::move(pSource);
+}
+
+void
+platform_subsystem_null::set_device_factory(null_device_factory pFactory) {
+    mDeviceFactory = std::move(pFactory);
+}
+
+void
+platform_subsystem_null::pre_init() {
+    mWindowManager = std::unique_ptr<window_manager_null>(
+        new window_manager_null()
+    );
+}
+
+void
+platform_subsystem_null::init(const subsystem_manager& pMgr) {
+    graphics_subsystem& graphicsSubsystem
+        = pMgr.lookup<graphics_subsystem>();
+
+    // The adapter defers to whatever device factory has been plugged in.
+    std::shared_ptr<graphics_adapter> nullAdapter
+        = std::make_shared<graphics_adapter>();
+    std::strcpy(nullAdapter->mName, sAdapterName);
+    null_device_factory factory = mDeviceFactory;
+    nullAdapter->mDeviceFactory = [factory]() {
+        if (!factory) {
+            throw std::logic_error("No headless graphics device factory");
+        }
+        return factory();
+    };
+    graphicsSubsystem.register_adapter(std::move(nullAdapter));
+
+    mWindowManager->init(pMgr.lookup<system_event_queue>(),
+        mWidth, mHeight, mConfig, mEventSource);
+}
+
+void
+platform_subsystem_null::post_init() {
+}
+
+void
+platform_subsystem_null::pre_shutdown() {
+}
+
+void
+platform_subsystem_null::shutdown() {
+    mWindowManager->shutdown();
+}
+
+void
+platform_subsystem_null::frame() {
+    mWindowManager->frame();
+}
+
+
+namespace detail {
+    platform_subsystem_null
+    sNullPlatform;
+}
+
+platform_subsystem& get_platform_subsystem()
+{
+    return detail::sNullPlatform;
+}
+
+platform_subsystem_null& get_null_platform_subsystem()
+{
+    return detail::sNullPlatform;
+}
+
+}
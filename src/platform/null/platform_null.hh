@@ -0,0 +1,78 @@
+#ifndef PLATFORM_NULL_HH_INCLUDED
+#define PLATFORM_NULL_HH_INCLUDED
+
+#include <utils.hh>
+#include <platform_subsystem.hh>
+#include <system_event.hh>
+#include <window.hh>
+#include <functional>
+
+namespace trillek {
+
+class window_manager_null;
+class graphics_device;
+
+// Fills pEvents with whatever input should arrive on the given frame.
+typedef std::function<void (uint64_t pFrame,
+        std::vector<system_event_t>& pEvents)> synthetic_event_source;
+
+typedef std::function<std::shared_ptr<graphics_device> ()>
+        null_device_factory;
+
+// Headless platform: a virtual main window with no display behind it,
+// input from a synthetic event source, and a graphics_device_null unless
+// the client plugs in another device. Used for benchmarks and soak tests on
+// machines with no display or GPU.
+class platform_subsystem_null : public platform_subsystem {
+private:
+    std::unique_ptr<window_manager_null> mWindowManager;
+
+    uint32_t mWidth;
+    uint32_t mHeight;
+    graphics_config_t mConfig;
+    synthetic_event_source mEventSource;
+    null_device_factory mDeviceFactory;
+
+public:
+    interface_key_t implements() const {
+        return platform_subsystem::s_interface;
+    }
+
+    virtual window_manager& get_window_manager();
+
+    std::vector<interface_key_t> dependencies() const;
+
+    platform_subsystem_null();
+
+    ~platform_subsystem_null();
+
+    // These must be called before the platform is initialised.
+
+    void set_window_size(uint32_t pWidth, uint32_t pHeight);
+
+    void set_graphics_config(const graphics_config_t& pConfig);
+
+    void set_event_source(synthetic_event_source pSource);
+
+    void set_device_factory(null_device_factory pFactory);
+
+    void pre_init();
+
+    void init(const subsystem_manager& pMgr);
+
+    void post_init();
+
+    void pre_shutdown();
+
+    void shutdown();
+
+    void frame();
+};
+
+// The same object as get_platform_subsystem(), for callers which need to
+// configure the headless platform before startup.
+platform_subsystem_null& get_null_platform_subsystem();
+
+}
+
+#endif // PLATFORM_NULL_HH_INCLUDED
@@ -0,0 +1,39 @@
+#include <window_manager_null.hh>
+#include <window_null.hh>
+
+namespace trillek {
+
+std::shared_ptr<window>
+window_manager_null::get_main_window()
+{
+    return mMainWindow;
+}
+
+void
+window_manager_null::init(system_event_queue& pQueue,
+        uint32_t pWidth, uint32_t pHeight,
+        const graphics_config_t& pConfig, synthetic_event_source pSource)
+{
+    mMainWindow = std::make_shared<window_null>(pQueue, pWidth, pHeight,
+        pConfig, std::move(pSource));
+}
+
+void
+window_manager_null::shutdown() {
+    mMainWindow.reset();
+}
+
+void
+window_manager_null::frame() {
+    mMainWindow->dispatch_events();
+}
+
+window_manager_null::window_manager_null()
+{
+}
+
+window_manager_null::~window_manager_null()
+{
+}
+
+}
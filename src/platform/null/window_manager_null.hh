@@ -0,0 +1,32 @@
+#ifndef WINDOW_MANAGER_NULL_HH_INCLUDED
+#define WINDOW_MANAGER_NULL_HH_INCLUDED
+
+#include <platform_null.hh>
+#include <window_manager.hh>
+#include <window_null.hh>
+
+namespace trillek {
+
+class window_manager_null : public window_manager {
+public:
+
+    std::shared_ptr<window> get_main_window();
+
+    void init(system_event_queue& pQueue, uint32_t pWidth, uint32_t pHeight,
+            const graphics_config_t& pConfig, synthetic_event_source pSource);
+
+    void shutdown();
+
+    void frame();
+
+    window_manager_null();
+
+    ~window_manager_null();
+
+private:
+    std::shared_ptr<window_null> mMainWindow;
+};
+
+}
+
+#endif // WINDOW_MANAGER_NULL_HH_INCLUDED
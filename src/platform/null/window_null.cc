@@ -0,0 +1,74 @@
+#include <window_null.hh>
+#include <window_target_null.hh>
+
+namespace trillek {
+
+window_null::window_null(system_event_queue& pQueue,
+        uint32_t pWidth, uint32_t pHeight,
+        const graphics_config_t& pConfig, synthetic_event_source pSource)
+    : mQueue(pQueue), mWidth(pWidth), mHeight(pHeight), mConfig(pConfig),
+      mSource(std::move(pSource))
+{
+    mFrame = 0;
+    mFramesPresented = 0;
+    mCoalesceMotion = false;
+}
+
+
+window_null::~window_null() {
+}
+
+std::shared_ptr<window_target>
+window_null::make_window_target(
+        const std::shared_ptr<graphics_device>& pDevice) {
+    return std::make_shared<window_target_null>(shared_from_this());
+}
+
+void
+window_null::get_dimensions(uint32_t& pWidth, uint32_t& pHeight) const
+{
+    pWidth = mWidth;
+    pHeight = mHeight;
+}
+
+void
+window_null::get_config(graphics_config_t& pConfig) const
+{
+    pConfig = mConfig;
+}
+
+void
+window_null::set_motion_coalescing(bool pEnable)
+{
+    if (!pEnable && mCoalesceMotion) {
+        mCoalescer.flush(mQueue);
+    }
+    mCoalesceMotion = pEnable;
+}
+
+void
+window_null::dispatch_events()
+{
+    if (mSource) {
+        mSource(mFrame, mPending);
+    }
+    ++mFrame;
+
+    for (auto& ev : mPending) {
+        if (mCoalesceMotion && ev.mType == EV_MOUSE) {
+            mCoalescer.add(ev.mSubtype, ev.mData);
+            continue;
+        }
+        if (mCoalesceMotion) {
+            mCoalescer.flush(mQueue);
+        }
+        mQueue.push(std::move(ev));
+    }
+    mPending.clear();
+
+    if (mCoalesceMotion) {
+        mCoalescer.flush(mQueue);
+    }
+}
+
+}
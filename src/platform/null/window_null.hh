@@ -0,0 +1,56 @@
+#ifndef WINDOW_NULL_HH_INCLUDED
+#define WINDOW_NULL_HH_INCLUDED
+
+#include <platform_null.hh>
+#include <window.hh>
+#include <motion_coalescer.hh>
+
+namespace trillek {
+
+    class window_null : public window,
+            public std::enable_shared_from_this<window_null> {
+    public:
+        window_null(system_event_queue& pQueue, uint32_t pWidth,
+                uint32_t pHeight, const graphics_config_t& pConfig,
+                synthetic_event_source pSource);
+
+        ~window_null();
+
+        virtual std::shared_ptr<window_target> make_window_target(
+            const std::shared_ptr<graphics_device>& pDevice
+        );
+
+        void get_dimensions(uint32_t& pWidth, uint32_t& pHeight) const;
+
+        virtual void get_config(graphics_config_t& pConfig) const;
+
+        virtual void set_motion_coalescing(bool pEnable);
+
+        void dispatch_events();
+
+        uint64_t frames_presented() const {
+            return mFramesPresented;
+        }
+
+        void present() {
+            ++mFramesPresented;
+        }
+
+    private:
+        system_event_queue& mQueue;
+        uint32_t mWidth;
+        uint32_t mHeight;
+        graphics_config_t mConfig;
+
+        synthetic_event_source mSource;
+        std::vector<system_event_t> mPending;
+        uint64_t mFrame;
+        uint64_t mFramesPresented;
+
+        bool mCoalesceMotion;
+        motion_coalescer mCoalescer;
+    };
+
+}
+
+#endif // WINDOW_NULL_HH_INCLUDED
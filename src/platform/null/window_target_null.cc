@@ -0,0 +1,69 @@
+#include <window_target_null.hh>
+#include <window_null.hh>
+
+namespace trillek {
+
+
+window_target_null::window_target_null(
+        const std::shared_ptr<window_null>& pWin)
+    : window_target(std::static_pointer_cast<window>(pWin)),
+      mWinNull(pWin)
+{
+}
+
+
+window_target_null::~window_target_null()
+{
+}
+
+
+format_t
+window_target_null::get_format() const
+{
+    return FORMAT_R8G8B8A8;
+}
+
+
+vector2i_t
+window_target_null::get_dimensions()
+{
+    uint32_t width, height;
+    mWinNull->get_dimensions(width, height);
+    return vector2i_t(width, height);
+}
+
+
+void
+window_target_null::select()
+{
+}
+
+
+void
+window_target_null::deselect()
+{
+}
+
+
+void
+window_target_null::copy_to_texture(texture& pTex)
+{
+}
+
+
+bool
+window_target_null::swap_buffers()
+{
+    mWinNull->present();
+    return true;
+}
+
+
+void
+window_target_null::make_context_current(bool pCurrent)
+{
+}
+
+
+
+}
@@ -0,0 +1,38 @@
+#ifndef WINDOW_TARGET_NULL_HH_INCLUDED
+#define WINDOW_TARGET_NULL_HH_INCLUDED
+
+#include <platform_null.hh>
+#include <render_target.hh>
+
+namespace trillek {
+
+    class window_null;
+
+    class window_target_null : public window_target {
+    public:
+        window_target_null(const std::shared_ptr<window_null>& pWin);
+
+        virtual ~window_target_null();
+
+        virtual format_t get_format() const;
+
+        virtual vector2i_t get_dimensions();
+
+        virtual void select();
+
+        virtual void deselect();
+
+        virtual void copy_to_texture(texture& pTex);
+
+        virtual bool swap_buffers();
+
+        virtual void make_context_current(bool pCurrent);
+
+    private:
+        std::shared_ptr<window_null> mWinNull;
+    };
+
+};
+
+
+#endif // WINDOW_TARGET_NULL_HH_INCLUDED
@@ -21,6 +21,14 @@ platform_subsystem_sfml::get_window_manager() {
     return *mWindowManager;
 }
 
+std::vector<interface_key_t>
+platform_subsystem_sfml::dependencies() const {
+    return std::vector<interface_key_t> {
+        graphics_subsystem::s_interface,
+        system_event_queue::s_interface
+    };
+}
+
 platform_subsystem_sfml::platform_subsystem_sfml() {
     mEventsActive = false;
 }
@@ -27,6 +27,13 @@ public:
 
     virtual window_manager& get_window_manager();
 
+    std::vector<interface_key_t> dependencies() const;
+
+    // The SFML window and its GL context live on the main thread.
+    bool main_thread_only() const {
+        return true;
+    }
+
     platform_subsystem_sfml();
 
     void pre_init();
@@ -17,6 +17,9 @@ window_sfml::window_sfml(system_event_queue& pQueue)
 
     mMouseX = 0;
     mMouseY = 0;
+
+    mCoalesceMotion = false;
+    mMouseWarpPending = false;
 }
 
 
@@ -49,9 +52,19 @@ window_sfml::get_config(graphics_config_t& pConfig) const
     pConfig.mAntialiasingLevel = mContextSettings.antialiasingLevel;
 }
 
+void
+window_sfml::set_motion_coalescing(bool pEnable)
+{
+    if (!pEnable && mCoalesceMotion) {
+        mCoalescer.flush(mQueue);
+    }
+    mCoalesceMotion = pEnable;
+}
+
 void
 window_sfml::open_window() {
-    sf::ContextSettings ctx(32, 8, 0, 3, 0);
+    sf::ContextSettings ctx(32, 8, 0, 3, 3);
+    ctx.attributeFlags = sf::ContextSettings::Core;
     mMainWin.create(sf::VideoMode(s_width,s_height),
         L"Trillek m1 test", sf::Style::Titlebar, ctx);
     mWinSize = mMainWin.getSize();
@@ -75,12 +88,22 @@ window_sfml::force_mouse_location() {
     sf::Mouse::setPosition(mWinCentre, mMainWin);
     mMouseX = mWinCentre.x;
     mMouseY = mWinCentre.y;
+    mMouseWarpPending = false;
+}
+
+
+// When coalescing, the pointer is only recentred once per frame, unless it
+// has wandered far enough that it might leave the window first.
+bool
+window_sfml::mouse_far_from_centre() const {
+    return std::abs(mMouseX - mWinCentre.x) > (int)mWinSize.x / 4
+        || std::abs(mMouseY - mWinCentre.y) > (int)mWinSize.y / 4;
 }
 
 
 void
-window_sfml::activate_for_gl() {
-    mMainWin.setActive();
+window_sfml::activate_for_gl(bool pActive) {
+    mMainWin.setActive(pActive);
 }
 
 void
@@ -245,6 +268,9 @@ window_sfml::dispatch_events()
         switch (event.type) {
             case sf::Event::KeyPressed:
             {
+                if (mCoalesceMotion) {
+                    mCoalescer.flush(mQueue);
+                }
                 trillek::keycode_t key = translate_key(event.key.code);
                 mQueue.push(system_event_t(EV_KEY, EV_K_DOWN, key));
                 break;
@@ -252,6 +278,9 @@ window_sfml::dispatch_events()
 
             case sf::Event::KeyReleased:
             {
+                if (mCoalesceMotion) {
+                    mCoalescer.flush(mQueue);
+                }
                 trillek::keycode_t key = translate_key(event.key.code);
                 mQueue.push(system_event_t(EV_KEY, EV_K_UP, key));
                 break;
@@ -271,6 +300,19 @@ window_sfml::dispatch_events()
                 }
                 mMouseX = event.mouseMove.x;
                 mMouseY = event.mouseMove.y;
+                if (mCoalesceMotion) {
+                    if (dx) {
+                        mCoalescer.add(EV_M_DX, dx);
+                    }
+                    if (dy) {
+                        mCoalescer.add(EV_M_DY, dy);
+                    }
+                    mMouseWarpPending = true;
+                    if (mouse_far_from_centre()) {
+                        force_mouse_location();
+                    }
+                    break;
+                }
                 force_mouse_location();
                 if (dx) {
                     mQueue.push(system_event_t(EV_MOUSE, EV_M_DX, dx));
@@ -286,7 +328,10 @@ window_sfml::dispatch_events()
                     break;
                 }
                 int dz = event.mouseWheel.delta;
-                if (dz) {
+                if (dz && mCoalesceMotion) {
+                    mCoalescer.add(EV_M_DZ, dz);
+                }
+                else if (dz) {
                     mQueue.push(system_event_t(EV_MOUSE, EV_M_DZ, dz));
                 }
                 break;
@@ -319,6 +364,13 @@ window_sfml::dispatch_events()
             }
         }
     }
+
+    if (mCoalesceMotion) {
+        mCoalescer.flush(mQueue);
+        if (mMouseWarpPending) {
+            force_mouse_location();
+        }
+    }
 }
 
 
@@ -4,6 +4,7 @@
 #include <platform_sfml.hh>
 #include <window.hh>
 #include <keycodes.hh>
+#include <motion_coalescer.hh>
 
 namespace trillek {
 
@@ -25,11 +26,13 @@ namespace trillek {
 
         virtual void get_config(graphics_config_t& pConfig) const;
 
+        virtual void set_motion_coalescing(bool pEnable);
+
         void open_window();
 
         void close_window();
 
-        void activate_for_gl();
+        void activate_for_gl(bool pActive = true);
 
         void swap_buffers();
 
@@ -50,6 +53,8 @@ namespace trillek {
 
         void force_mouse_location();
 
+        bool mouse_far_from_centre() const;
+
         sf::Window mMainWin;
         sf::Vector2u mWinSize;
         sf::Vector2i mWinCentre;
@@ -63,6 +68,10 @@ namespace trillek {
 
         int mMouseX;
         int mMouseY;
+
+        bool mCoalesceMotion;
+        bool mMouseWarpPending;
+        motion_coalescer mCoalescer;
     };
 
 
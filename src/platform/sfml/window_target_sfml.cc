@@ -59,6 +59,13 @@ window_target_sfml::swap_buffers()
 }
 
 
+void
+window_target_sfml::make_context_current(bool pCurrent)
+{
+    mWinSfml->activate_for_gl(pCurrent);
+}
+
+
 
 }
 
@@ -28,6 +28,8 @@ namespace trillek {
 
         virtual bool swap_buffers();
 
+        virtual void make_context_current(bool pCurrent);
+
     private:
 	std::weak_ptr<graphics_device_gl> mDevice;
 	std::shared_ptr<window_sfml> mWinSfml;
@@ -2,6 +2,7 @@
 #define SUBSYSTEM_HH_INCLUDED
 
 #include <utils.hh>
+#include <chrono>
 
 namespace trillek {
 
@@ -9,6 +10,21 @@ namespace trillek {
 
     typedef const char* interface_key_t;
 
+    enum subsystem_phase_t {
+        PHASE_PRE_INIT = 0,
+        PHASE_INIT,
+        PHASE_POST_INIT,
+        PHASE_LAST
+    };
+
+    // How long one subsystem spent in each startup phase. The manager
+    // reports itself under its own interface key, with the wall-clock
+    // time of each phase.
+    struct subsystem_timing_t {
+        interface_key_t mKey;
+        std::array<std::chrono::microseconds, PHASE_LAST> mPhase;
+    };
+
     class subsystem
     {
     public:
@@ -31,6 +47,22 @@ namespace trillek {
         virtual void pre_shutdown() = 0;
         virtual void shutdown() = 0;
 
+        // Interfaces which this subsystem looks up. Each startup phase of
+        // this subsystem only runs once the same phase has completed on
+        // everything it depends on; independent subsystems may run their
+        // phases concurrently on the manager's worker threads.
+
+        virtual std::vector<interface_key_t> dependencies() const {
+            return std::vector<interface_key_t>();
+        }
+
+        // Subsystems which own windows or graphics contexts must be set
+        // up on the thread which called subsystem_manager::initialise().
+
+        virtual bool main_thread_only() const {
+            return false;
+        }
+
     protected:
         virtual ~subsystem();
     };
@@ -50,6 +82,14 @@ namespace trillek {
 
         virtual subsystem* lookup(interface_key_t pKey) const = 0;
 
+        // Number of threads (including the calling thread) used to run
+        // independent startup phases. 1 means strictly serial start-up
+        // in load order.
+        virtual void set_worker_threads(unsigned pThreads) = 0;
+
+        virtual const std::vector<subsystem_timing_t>&
+        startup_timings() const = 0;
+
         template<class T> T&
         lookup() const {
             interface_key_t key = T::s_interface;
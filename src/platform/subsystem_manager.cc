@@ -1,16 +1,187 @@
 #include <subsystem.hh>
 #include <unordered_map>
 #include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stdexcept>
+#include <algorithm>
 
 namespace trillek { namespace detail {
 
+// Runs one startup phase over the subsystem dependency graph. Subsystems
+// become ready when every subsystem they depend on has finished the phase.
+// The calling thread takes part in the work, and is the only thread which
+// runs main_thread_only() subsystems.
+//
+// If a subsystem throws, everything which depends on it is skipped, and
+// once the phase has drained the error from the earliest-loaded failing
+// subsystem is rethrown. That keeps the reported failure independent of
+// thread timing.
+
+class subsystem_phase_runner : private boost::noncopyable {
+public:
+    typedef void (*phase_fn)(subsystem&, const subsystem_manager&);
+
+private:
+    struct node {
+        subsystem* mSubsystem;
+        std::vector<uint32_t> mDependents;
+        uint32_t mWaitingOn;
+        bool mSkip;
+        std::exception_ptr mError;
+        std::chrono::microseconds mTime;
+    };
+
+    const subsystem_manager& mMgr;
+    phase_fn mPhase;
+    std::vector<node> mNodes;
+    uint32_t mRemaining;
+
+    std::mutex mLock;
+    std::condition_variable mWake;
+    std::deque<uint32_t> mReadyAny;
+    std::deque<uint32_t> mReadyMain;
+
+    void make_ready(uint32_t pNode) {
+        if (mNodes[pNode].mSubsystem->main_thread_only()) {
+            mReadyMain.push_back(pNode);
+        }
+        else {
+            mReadyAny.push_back(pNode);
+        }
+    }
+
+    // Called with mLock held.
+    void complete(uint32_t pNode) {
+        node& n = mNodes[pNode];
+        bool failed = n.mSkip || n.mError;
+        --mRemaining;
+        for (uint32_t d : n.mDependents) {
+            node& dep = mNodes[d];
+            if (failed) {
+                dep.mSkip = true;
+            }
+            if (--dep.mWaitingOn == 0) {
+                if (dep.mSkip) {
+                    complete(d);
+                }
+                else {
+                    make_ready(d);
+                }
+            }
+        }
+    }
+
+    void run_node(uint32_t pNode) {
+        node& n = mNodes[pNode];
+        auto start = std::chrono::steady_clock::now();
+        try {
+            mPhase(*n.mSubsystem, mMgr);
+        }
+        catch (...) {
+            n.mError = std::current_exception();
+        }
+        n.mTime = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start
+        );
+    }
+
+    void work(bool pMainThread) {
+        std::unique_lock<std::mutex> lock(mLock);
+        for (;;) {
+            uint32_t next;
+            if (pMainThread && !mReadyMain.empty()) {
+                next = mReadyMain.front();
+                mReadyMain.pop_front();
+            }
+            else if (!mReadyAny.empty()) {
+                next = mReadyAny.front();
+                mReadyAny.pop_front();
+            }
+            else if (mRemaining == 0) {
+                return;
+            }
+            else {
+                mWake.wait(lock);
+                continue;
+            }
+
+            lock.unlock();
+            run_node(next);
+            lock.lock();
+            complete(next);
+            mWake.notify_all();
+        }
+    }
+
+public:
+    subsystem_phase_runner(const subsystem_manager& pMgr, phase_fn pPhase,
+            const std::vector<subsystem*>& pSubsystems,
+            const std::vector<std::vector<uint32_t>>& pDependencies)
+        : mMgr(pMgr), mPhase(pPhase)
+    {
+        mNodes.resize(pSubsystems.size());
+        for (uint32_t i = 0; i < mNodes.size(); ++i) {
+            node& n = mNodes[i];
+            n.mSubsystem = pSubsystems[i];
+            n.mWaitingOn = pDependencies[i].size();
+            n.mSkip = false;
+            n.mTime = std::chrono::microseconds(0);
+            for (uint32_t d : pDependencies[i]) {
+                mNodes[d].mDependents.push_back(i);
+            }
+        }
+        mRemaining = mNodes.size();
+    }
+
+    std::chrono::microseconds time(uint32_t pNode) const {
+        return mNodes[pNode].mTime;
+    }
+
+    void run(unsigned pThreads) {
+        for (uint32_t i = 0; i < mNodes.size(); ++i) {
+            if (mNodes[i].mWaitingOn == 0) {
+                make_ready(i);
+            }
+        }
+
+        std::vector<std::thread> workers;
+        for (unsigned i = 1; i < pThreads; ++i) {
+            workers.emplace_back(&subsystem_phase_runner::work, this, false);
+        }
+        work(true);
+        for (auto& w : workers) {
+            w.join();
+        }
+
+        for (auto& n : mNodes) {
+            if (n.mError) {
+                std::rethrow_exception(n.mError);
+            }
+        }
+    }
+};
+
+
 class subsystem_manager_impl : public subsystem_manager {
 private:
     std::vector< subsystem* > mSubsystems;
     std::unordered_map<interface_key_t,subsystem*> mIfMap;
 
+    unsigned mWorkerThreads;
+    std::vector<subsystem_timing_t> mTimings;
+
+    // Indices into mSubsystems, per subsystem, of what it depends on.
+    std::vector<std::vector<uint32_t>> build_dependency_graph() const;
+
+    void run_phase(subsystem_phase_t pPhase,
+                   subsystem_phase_runner::phase_fn pFn);
+
 public:
     subsystem_manager_impl() {
+        mWorkerThreads = std::max(1u, std::thread::hardware_concurrency());
     }
 
     ~subsystem_manager_impl();
@@ -20,21 +191,36 @@ public:
     }
 
     void pre_init() {
+        mTimings.clear();
         for (auto s: mSubsystems) {
-            s->pre_init();
+            subsystem_timing_t t;
+            t.mKey = s->implements();
+            t.mPhase.fill(std::chrono::microseconds(0));
+            mTimings.push_back(t);
         }
+        subsystem_timing_t total;
+        total.mKey = implements();
+        total.mPhase.fill(std::chrono::microseconds(0));
+        mTimings.push_back(total);
+
+        run_phase(PHASE_PRE_INIT,
+            [](subsystem& pS, const subsystem_manager&) {
+                pS.pre_init();
+            });
     }
 
     void init(const subsystem_manager& pMgr) {
-        for (auto s: mSubsystems) {
-            s->init(pMgr);
-        }
+        run_phase(PHASE_INIT,
+            [](subsystem& pS, const subsystem_manager& pMgr) {
+                pS.init(pMgr);
+            });
     }
 
     void post_init() {
-        for (auto s: mSubsystems) {
-            s->post_init();
-        }
+        run_phase(PHASE_POST_INIT,
+            [](subsystem& pS, const subsystem_manager&) {
+                pS.post_init();
+            });
     }
 
     void pre_shutdown() {
@@ -66,6 +252,15 @@ public:
             return nullptr;
         }
     }
+
+    void set_worker_threads(unsigned pThreads) {
+        mWorkerThreads = std::max(1u, pThreads);
+    }
+
+    const std::vector<subsystem_timing_t>&
+    startup_timings() const {
+        return mTimings;
+    }
 };
 
 subsystem_manager_impl::~subsystem_manager_impl()
@@ -73,6 +268,100 @@ subsystem_manager_impl::~subsystem_manager_impl()
 }
 
 
+std::vector<std::vector<uint32_t>>
+subsystem_manager_impl::build_dependency_graph() const
+{
+    std::unordered_map<const subsystem*,uint32_t> index;
+    for (uint32_t i = 0; i < mSubsystems.size(); ++i) {
+        index[mSubsystems[i]] = i;
+    }
+
+    std::vector<std::vector<uint32_t>> deps(mSubsystems.size());
+    for (uint32_t i = 0; i < mSubsystems.size(); ++i) {
+        for (interface_key_t key : mSubsystems[i]->dependencies()) {
+            subsystem* dep = lookup(key);
+            if (!dep) {
+                throw std::logic_error(
+                    "subsystem_manager: missing subsystem dependency"
+                );
+            }
+            deps[i].push_back(index[dep]);
+        }
+    }
+
+    // Kahn's algorithm, purely to reject cycles up front; otherwise the
+    // phase runner would wait forever.
+    std::vector<uint32_t> waiting(deps.size());
+    std::vector<std::vector<uint32_t>> dependents(deps.size());
+    std::vector<uint32_t> ready;
+    for (uint32_t i = 0; i < deps.size(); ++i) {
+        waiting[i] = deps[i].size();
+        for (uint32_t d : deps[i]) {
+            dependents[d].push_back(i);
+        }
+        if (!waiting[i]) {
+            ready.push_back(i);
+        }
+    }
+    uint32_t visited = 0;
+    while (!ready.empty()) {
+        uint32_t i = ready.back();
+        ready.pop_back();
+        ++visited;
+        for (uint32_t d : dependents[i]) {
+            if (--waiting[d] == 0) {
+                ready.push_back(d);
+            }
+        }
+    }
+    if (visited != deps.size()) {
+        throw std::logic_error("subsystem_manager: dependency cycle");
+    }
+
+    return deps;
+}
+
+
+void
+subsystem_manager_impl::run_phase(subsystem_phase_t pPhase,
+                   subsystem_phase_runner::phase_fn pFn)
+{
+    std::vector<std::vector<uint32_t>> deps;
+    if (mWorkerThreads > 1) {
+        deps = build_dependency_graph();
+    }
+    else {
+        // Serial start-up: chain everything in load order.
+        deps.resize(mSubsystems.size());
+        for (uint32_t i = 1; i < mSubsystems.size(); ++i) {
+            deps[i].push_back(i - 1);
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    subsystem_phase_runner runner(*this, pFn, mSubsystems, deps);
+    std::exception_ptr error;
+    try {
+        runner.run(mWorkerThreads);
+    }
+    catch (...) {
+        error = std::current_exception();
+    }
+
+    for (uint32_t i = 0; i < mSubsystems.size(); ++i) {
+        mTimings[i].mPhase[pPhase] = runner.time(i);
+    }
+    mTimings.back().mPhase[pPhase]
+        = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start
+        );
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+
 } }
 
 namespace trillek {
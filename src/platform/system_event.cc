@@ -0,0 +1,67 @@
+#include "system_event.hh"
+
+#include <mutex>
+
+namespace trillek { namespace detail {
+
+// Free list of EV_POOLED_DATA_SIZE blocks for system event payloads which
+// don't fit inline. Blocks are never returned to the heap; large payloads
+// are rare, so the pool stays small and the lock is uncontended.
+class system_event_data_pool : private boost::noncopyable {
+private:
+    union block_t {
+        block_t* mNext;
+        alignas(8) unsigned char mData[EV_POOLED_DATA_SIZE];
+    };
+
+    std::mutex mLock;
+    block_t* mFree;
+    std::vector<std::unique_ptr<block_t>> mBlocks;
+
+public:
+    system_event_data_pool()
+        : mFree(nullptr)
+    {
+    }
+
+    void* alloc() {
+        std::lock_guard<std::mutex> lock(mLock);
+        if (!mFree) {
+            mBlocks.emplace_back(new block_t);
+            return mBlocks.back()->mData;
+        }
+        block_t* b = mFree;
+        mFree = b->mNext;
+        return b->mData;
+    }
+
+    void free(void* pBlock) {
+        std::lock_guard<std::mutex> lock(mLock);
+        block_t* b = reinterpret_cast<block_t*>(pBlock);
+        b->mNext = mFree;
+        mFree = b;
+    }
+};
+
+static system_event_data_pool&
+event_data_pool() {
+    static system_event_data_pool sPool;
+    return sPool;
+}
+
+} }
+
+
+namespace trillek {
+
+void*
+alloc_system_event_data() {
+    return detail::event_data_pool().alloc();
+}
+
+void
+free_system_event_data(void* pBlock) {
+    detail::event_data_pool().free(pBlock);
+}
+
+}
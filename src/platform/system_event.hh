@@ -4,6 +4,8 @@
 #include "subsystem.hh"
 
 #include <memory>
+#include <stdexcept>
+#include <type_traits>
 
 namespace trillek {
     // Event types
@@ -30,43 +32,196 @@ namespace trillek {
         EV_K_LAST
     };
 
-    // Base class for extra data associated with a system event.
-    struct system_event_data {
+    // Extra data attached to a system event is a plain, trivially copyable
+    // struct with a unique s_tag. Payloads of up to EV_INLINE_DATA_SIZE
+    // bytes are stored inside the event itself, so posting one never
+    // allocates; larger payloads (up to EV_POOLED_DATA_SIZE) come from a
+    // shared block pool.
+    enum system_event_data_tag_t {
+        EVDATA_NONE = 0,
+        EVDATA_MOUSE_MOTION,
+        EVDATA_LAST
     };
 
-    typedef std::unique_ptr<system_event_data> system_event_data_ptr;
+    static constexpr unsigned EV_INLINE_DATA_SIZE = 24;
+    static constexpr unsigned EV_POOLED_DATA_SIZE = 512;
+
+    void* alloc_system_event_data();
+    void free_system_event_data(void* pBlock);
+
+    // Attached to EV_MOUSE events which were built by merging several
+    // motion samples. Times are in microseconds from an arbitrary
+    // monotonic epoch.
+    struct mouse_motion_data {
+        static constexpr system_event_data_tag_t s_tag = EVDATA_MOUSE_MOTION;
+
+        uint32_t mSamples;
+        uint64_t mFirstTime;
+        uint64_t mLastTime;
+    };
 
     struct system_event_t {
         system_event_type_t mType;
         unsigned mSubtype;
         int mData;
-        system_event_data_ptr mExtraData;
+
+        bool has_extra_data() const {
+            return mDataTag != EVDATA_NONE;
+        }
+
+        system_event_data_tag_t extra_data_tag() const {
+            return mDataTag;
+        }
 
         template<typename T>
         const T& extra_data() const
         {
-            return *std::static_pointer_cast<T>(mExtraData);
+            if (mDataTag != T::s_tag) {
+                throw std::logic_error("system_event_t::extra_data");
+            }
+            return *reinterpret_cast<const T*>(data_ptr());
+        }
+
+        template<typename T>
+        void set_extra_data(const T& pData)
+        {
+            static_assert(std::is_trivially_copyable<T>::value,
+                "system event data must be trivially copyable");
+            static_assert(sizeof(T) <= EV_POOLED_DATA_SIZE,
+                "system event data too large");
+            set_raw_extra_data(T::s_tag, &pData, sizeof(T));
+        }
+
+        // Untyped payload access, for serialising events.
+
+        uint32_t extra_data_size() const {
+            return mDataSize;
+        }
+
+        const void* raw_extra_data() const {
+            return data_ptr();
+        }
+
+        void set_raw_extra_data(system_event_data_tag_t pTag,
+                const void* pData, uint32_t pSize)
+        {
+            if (pSize > EV_POOLED_DATA_SIZE) {
+                throw std::invalid_argument("system_event_t::set_raw_extra_data");
+            }
+            release_data();
+            mDataPooled = pSize > EV_INLINE_DATA_SIZE;
+            if (mDataPooled) {
+                mPooled = alloc_system_event_data();
+            }
+            std::memcpy(data_ptr(), pData, pSize);
+            mDataTag = pTag;
+            mDataSize = pSize;
         }
 
         explicit system_event_t(system_event_type_t pType = EV_NONE,
                        unsigned pSubtype = 0, int pData = 0)
-            : mType(pType), mSubtype(pSubtype), mData(pData)
+            : mType(pType), mSubtype(pSubtype), mData(pData),
+              mDataTag(EVDATA_NONE), mDataPooled(false), mDataSize(0)
         {
         }
 
+        template<typename T>
         system_event_t(system_event_type_t pType, unsigned pSubtype, int pData,
-                system_event_data_ptr pExtraData)
+                const T& pExtraData)
             : mType(pType), mSubtype(pSubtype), mData(pData),
-              mExtraData(std::move(pExtraData))
+              mDataTag(EVDATA_NONE), mDataPooled(false), mDataSize(0)
         {
+            set_extra_data(pExtraData);
+        }
+
+        // Moving an event is a plain byte copy; only pooled payloads have
+        // an owner to hand over.
+        system_event_t(system_event_t&& pEvent) {
+            std::memcpy((void*)this, &pEvent, sizeof(system_event_t));
+            pEvent.mDataTag = EVDATA_NONE;
+            pEvent.mDataPooled = false;
+            pEvent.mDataSize = 0;
+        }
+
+        system_event_t& operator=(system_event_t&& pEvent) {
+            if (this != &pEvent) {
+                release_data();
+                std::memcpy((void*)this, &pEvent, sizeof(system_event_t));
+                pEvent.mDataTag = EVDATA_NONE;
+                pEvent.mDataPooled = false;
+                pEvent.mDataSize = 0;
+            }
+            return *this;
+        }
+
+        system_event_t(const system_event_t&) = delete;
+        system_event_t& operator=(const system_event_t&) = delete;
+
+        ~system_event_t() {
+            release_data();
+        }
+
+    private:
+        system_event_data_tag_t mDataTag;
+        bool mDataPooled;
+        uint16_t mDataSize;
+        union {
+            alignas(8) unsigned char mInline[EV_INLINE_DATA_SIZE];
+            void* mPooled;
+        };
+
+        const void* data_ptr() const {
+            return mDataPooled ? mPooled : mInline;
         }
+
+        void* data_ptr() {
+            return mDataPooled ? mPooled : mInline;
+        }
+
+        void release_data() {
+            if (mDataPooled) {
+                free_system_event_data(mPooled);
+                mDataPooled = false;
+            }
+            mDataTag = EVDATA_NONE;
+            mDataSize = 0;
+        }
+    };
+
+    // What push() does when the queue is full.
+    enum system_event_overflow_t {
+        EVQ_OVERFLOW_DROP = 0,  // Discard the new event (counted).
+        EVQ_OVERFLOW_BLOCK,     // Wait for the consumer to make room.
+                                // Never use this if the consuming thread
+                                // also pushes events.
+        EVQ_OVERFLOW_GROW,      // Chain on a ring of twice the size.
+                                // Rings stop growing at 65536 events;
+                                // after that this behaves like
+                                // EVQ_OVERFLOW_DROP. Drained rings are
+                                // freed once no producer can see them.
+        EVQ_OVERFLOW_LAST
+    };
+
+    struct system_event_queue_stats {
+        uint32_t mCapacity;
+        uint32_t mHighWater;    // Most events ever pending at once.
+        uint64_t mPushed;
+        uint64_t mDropped;
     };
 
+    // Any number of threads may push(); only one thread may consume with
+    // more_events()/get()/clear().
     class system_event_queue : public subsystem
     {
     public:
         static constexpr interface_key_t s_interface = "SystemEventQueue-1";
 
+        // Must be called while no other thread is using the queue.
+        virtual void configure(uint32_t pCapacity,
+                system_event_overflow_t pOverflow) = 0;
+
+        virtual void get_stats(system_event_queue_stats& pStats) const = 0;
+
         virtual void clear() = 0;
 
         virtual void push(system_event_t pEvent) = 0;
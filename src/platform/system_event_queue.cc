@@ -1,26 +1,182 @@
 #include "system_event.hh"
 
+#include <atomic>
+#include <thread>
+#include <stdexcept>
+#include <algorithm>
+
 namespace {
     static constexpr unsigned QUEUE_SIZE_BITS = 8;
     static constexpr unsigned QUEUE_SIZE = 1 << QUEUE_SIZE_BITS;
-    static constexpr unsigned QUEUE_MASK = QUEUE_SIZE - 1;
+
+    // EVQ_OVERFLOW_GROW stops doubling the ring here.
+    static constexpr unsigned QUEUE_MAX_GROWN_SIZE = 1 << 16;
+
+    static constexpr unsigned CACHE_LINE = 64;
+
+    uint32_t round_up_pow2(uint32_t pX) {
+        uint32_t n = 1;
+        while (n < pX) {
+            n <<= 1;
+        }
+        return n;
+    }
 }
 
 
 namespace trillek { namespace detail {
 
+// One bounded multi-producer ring (Vyukov's sequenced-cell design). Each
+// cell carries a sequence number which tells producers when the slot is
+// free and the consumer when its event has been published, so producers
+// only ever contend on a single CAS of mEnqueuePos.
+//
+// A ring can be closed by setting SEG_CLOSED in mEnqueuePos. After that no
+// producer can claim a slot in it, and they move on to mNext instead. This
+// is what keeps events in order when EVQ_OVERFLOW_GROW chains on a larger
+// ring. mBase numbers the ring's first slot in the queue as a whole, so
+// that position + mBase is an event's place in the queue.
+
+class system_event_segment : private boost::noncopyable {
+public:
+    static constexpr uint64_t SEG_CLOSED = 1ull << 63;
+
+    enum push_result_t {
+        SEG_PUSHED,
+        SEG_FULL,
+        SEG_IS_CLOSED
+    };
+
+private:
+    struct cell {
+        std::atomic<uint64_t> mSequence;
+        system_event_t mEvent;
+    };
+
+    std::unique_ptr<cell[]> mCells;
+    uint64_t mMask;
+    uint64_t mBase;
+
+    char mPad0[CACHE_LINE];
+    std::atomic<uint64_t> mEnqueuePos;
+    char mPad1[CACHE_LINE];
+    uint64_t mDequeuePos;
+    char mPad2[CACHE_LINE];
+
+public:
+    std::atomic<system_event_segment*> mNext;
+
+    system_event_segment(uint32_t pCapacity, uint64_t pBase)
+        : mCells(new cell[pCapacity]), mMask(pCapacity - 1), mBase(pBase),
+          mEnqueuePos(0), mDequeuePos(0), mNext(nullptr)
+    {
+        for (uint32_t i = 0; i < pCapacity; ++i) {
+            mCells[i].mSequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    ~system_event_segment() {
+        delete mNext.load(std::memory_order_relaxed);
+    }
+
+    uint32_t capacity() const {
+        return mMask + 1;
+    }
+
+    // The base for the ring chained after this one. Only meaningful once
+    // the ring is closed, when its final position no longer changes.
+    uint64_t next_base() const {
+        uint64_t pos = mEnqueuePos.load(std::memory_order_acquire);
+        return mBase + (pos & ~SEG_CLOSED);
+    }
+
+    // On SEG_PUSHED, pTicket is the event's place in the queue.
+    push_result_t try_push(system_event_t&& pEvent, bool pCloseWhenFull,
+            uint64_t& pTicket) {
+        uint64_t pos = mEnqueuePos.load(std::memory_order_relaxed);
+        for (;;) {
+            if (pos & SEG_CLOSED) {
+                return SEG_IS_CLOSED;
+            }
+            cell& c = mCells[pos & mMask];
+            uint64_t seq = c.mSequence.load(std::memory_order_acquire);
+            int64_t dif = (int64_t)seq - (int64_t)pos;
+            if (dif == 0) {
+                if (mEnqueuePos.compare_exchange_weak(pos, pos + 1,
+                        std::memory_order_relaxed)) {
+                    c.mEvent = std::move(pEvent);
+                    c.mSequence.store(pos + 1, std::memory_order_release);
+                    pTicket = mBase + pos;
+                    return SEG_PUSHED;
+                }
+            }
+            else if (dif < 0) {
+                if (!pCloseWhenFull) {
+                    return SEG_FULL;
+                }
+                if (mEnqueuePos.compare_exchange_weak(pos, pos | SEG_CLOSED,
+                        std::memory_order_relaxed)) {
+                    return SEG_IS_CLOSED;
+                }
+            }
+            else {
+                pos = mEnqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Consumer only.
+    bool ready() const {
+        const cell& c = mCells[mDequeuePos & mMask];
+        return c.mSequence.load(std::memory_order_acquire) == mDequeuePos + 1;
+    }
+
+    // Consumer only; call ready() first.
+    system_event_t pop() {
+        cell& c = mCells[mDequeuePos & mMask];
+        system_event_t ev = std::move(c.mEvent);
+        c.mSequence.store(mDequeuePos + mMask + 1, std::memory_order_release);
+        ++mDequeuePos;
+        return ev;
+    }
+
+    // Consumer only. True once the ring is closed and every event which
+    // made it in has been taken out.
+    bool retired() const {
+        uint64_t pos = mEnqueuePos.load(std::memory_order_acquire);
+        return (pos & SEG_CLOSED) && (pos & ~SEG_CLOSED) == mDequeuePos;
+    }
+};
+
+
 class system_event_queue_impl : public system_event_queue
 {
 public:
 
-    bool mActive;
-    system_event_t mQueue[QUEUE_SIZE];
-    unsigned mHead;
-    unsigned mTail;
+    std::atomic<bool> mActive;
+    system_event_overflow_t mOverflow;
+
+    // mFirst owns the chain of rings up to mTail. The consumer frees the
+    // rings before mHead once they are drained, mTail has moved past
+    // them and no producer is inside push(), since a producer may still
+    // be looking at a retired ring's header. Only EVQ_OVERFLOW_GROW
+    // chains rings, so only it counts mProducers.
+    std::unique_ptr<system_event_segment> mFirst;
+    std::atomic<system_event_segment*> mTail;
+    mutable system_event_segment* mHead;
+    std::atomic<uint32_t> mProducers;
+
+    std::atomic<uint64_t> mPushed;
+    // Counted before each slot is handed back, so a producer which has
+    // claimed a slot sees every pop that made room for it.
+    std::atomic<uint64_t> mPopped;
+    std::atomic<uint64_t> mDropped;
+    std::atomic<uint32_t> mHighWater;
 
     system_event_queue_impl() {
         mActive = false;
-        mHead = mTail = 0;
+        mProducers = 0;
+        configure(QUEUE_SIZE, EVQ_OVERFLOW_GROW);
     }
 
     interface_key_t implements() const {
@@ -45,34 +201,149 @@ public:
     void shutdown() {
     }
 
+    void configure(uint32_t pCapacity, system_event_overflow_t pOverflow) {
+        if (mActive) {
+            throw std::logic_error("system_event_queue::configure");
+        }
+        mOverflow = pOverflow;
+        mFirst.reset(new system_event_segment(
+            round_up_pow2(std::max(2u, pCapacity)), 0
+        ));
+        mHead = mFirst.get();
+        mTail = mHead;
+        mPushed = 0;
+        mPopped = 0;
+        mDropped = 0;
+        mHighWater = 0;
+    }
+
+    void get_stats(system_event_queue_stats& pStats) const {
+        pStats.mCapacity = mTail.load(std::memory_order_acquire)->capacity();
+        pStats.mHighWater = mHighWater.load(std::memory_order_relaxed);
+        pStats.mPushed = mPushed.load(std::memory_order_relaxed);
+        pStats.mDropped = mDropped.load(std::memory_order_relaxed);
+    }
+
     void clear() {
         while (more_events()) {
             get();
         }
     }
 
-    bool full() const {
-        return ((mTail + 1) & QUEUE_MASK) == mHead;
+    // pTicket orders this push against the pops, unlike mPushed, which
+    // other producers may not have bumped yet. The consumer may already
+    // have taken this event and more, hence the clamp.
+    void record_push(uint64_t pTicket) {
+        mPushed.fetch_add(1, std::memory_order_relaxed);
+        int64_t ahead = (int64_t)(pTicket + 1)
+            - (int64_t)mPopped.load(std::memory_order_relaxed);
+        uint32_t pending = (uint32_t)std::max<int64_t>(ahead, 0);
+        uint32_t hw = mHighWater.load(std::memory_order_relaxed);
+        while (pending > hw && !mHighWater.compare_exchange_weak(hw, pending,
+                std::memory_order_relaxed)) {
+        }
+    }
+
+    system_event_segment* grow(system_event_segment* pFull) {
+        system_event_segment* next = pFull->mNext.load(std::memory_order_acquire);
+        if (!next) {
+            std::unique_ptr<system_event_segment> seg(
+                new system_event_segment(pFull->capacity() * 2,
+                    pFull->next_base())
+            );
+            if (pFull->mNext.compare_exchange_strong(next, seg.get(),
+                    std::memory_order_acq_rel)) {
+                next = seg.release();
+            }
+        }
+        // seq_cst to pair with the mTail loads in push_to_tail() and
+        // free_retired().
+        mTail.compare_exchange_strong(pFull, next, std::memory_order_seq_cst);
+        return next;
     }
 
     virtual void push(system_event_t pEvent)  {
-        if (full()) {
-            get();
+        bool grows = mOverflow == EVQ_OVERFLOW_GROW;
+        if (grows) {
+            mProducers.fetch_add(1, std::memory_order_seq_cst);
+        }
+        push_to_tail(std::move(pEvent), grows);
+        if (grows) {
+            mProducers.fetch_sub(1, std::memory_order_release);
+        }
+    }
+
+    void push_to_tail(system_event_t&& pEvent, bool pGrows) {
+        system_event_segment* seg = mTail.load(std::memory_order_seq_cst);
+        uint64_t ticket = 0;
+        for (;;) {
+            bool canGrow = pGrows
+                && seg->capacity() * 2 <= QUEUE_MAX_GROWN_SIZE;
+
+            switch (seg->try_push(std::move(pEvent), canGrow, ticket)) {
+            case system_event_segment::SEG_PUSHED:
+                record_push(ticket);
+                return;
+
+            case system_event_segment::SEG_IS_CLOSED:
+                seg = grow(seg);
+                break;
+
+            case system_event_segment::SEG_FULL:
+                if (mOverflow == EVQ_OVERFLOW_BLOCK && mActive) {
+                    std::this_thread::yield();
+                    break;
+                }
+                mDropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+        }
+    }
+
+    // Consumer only. A producer which arrives after mProducers is seen
+    // to be zero loads mTail after we did, so it can only reach rings
+    // from there on.
+    void free_retired() {
+        if (mFirst.get() == mHead) {
+            return;
+        }
+        system_event_segment* tail = mTail.load(std::memory_order_seq_cst);
+        if (mProducers.load(std::memory_order_seq_cst) != 0) {
+            return;
+        }
+        while (mFirst.get() != mHead && mFirst.get() != tail) {
+            system_event_segment* next
+                = mFirst->mNext.load(std::memory_order_relaxed);
+            mFirst->mNext.store(nullptr, std::memory_order_relaxed);
+            mFirst.reset(next);
+        }
+    }
+
+    // Skip over rings which are closed and drained.
+    void advance_head() const {
+        while (mHead->retired()) {
+            system_event_segment* next
+                = mHead->mNext.load(std::memory_order_acquire);
+            if (!next) {
+                break;
+            }
+            mHead = next;
         }
-        mTail = (mTail + 1) & QUEUE_MASK;
-        mQueue[mTail] = std::move(pEvent);
     }
 
     virtual bool more_events() const {
-        return mHead != mTail;
+        advance_head();
+        return mHead->ready();
     }
 
     virtual system_event_t get()  {
-        if (mHead == mTail) {
+        if (!more_events()) {
             return system_event_t(EV_NONE);
         }
-        auto ev = std::move(mQueue[mHead]);
-        mHead = (mHead + 1) & QUEUE_MASK;
+        mPopped.store(mPopped.load(std::memory_order_relaxed) + 1,
+            std::memory_order_relaxed);
+        system_event_t ev = mHead->pop();
+        free_retired();
         return ev;
     }
 };
@@ -92,4 +363,3 @@ namespace trillek {
 }
 
 
-
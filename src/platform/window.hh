@@ -29,6 +29,10 @@ namespace trillek {
 
         virtual void get_config(graphics_config_t& pConfig) const = 0;
 
+        // Merge relative mouse motion and wheel events into at most one
+        // event per axis per frame. Off by default.
+        virtual void set_motion_coalescing(bool pEnable) = 0;
+
     protected:
         window();
     };
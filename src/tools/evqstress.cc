@@ -0,0 +1,129 @@
+// Multi-producer stress check for the system event queue.
+//
+//   trillek-evqstress [producers] [events-per-producer]
+//
+// Every overflow policy is run with a small ring while several threads
+// push at once. Each event carries its producer and sequence number, so
+// the consumer checks that nothing arrives out of order or twice, and
+// that every event was either delivered or counted as dropped. The
+// high-water mark must never exceed what the rings could hold: one ring
+// for DROP and BLOCK, and the chain of doubling rings (less than twice
+// the last) for GROW.
+
+#include <system_event.hh>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace trillek {
+    extern system_event_queue& get_system_event_queue();
+}
+
+namespace {
+
+    const char*
+    policy_name(trillek::system_event_overflow_t pOverflow) {
+        switch (pOverflow) {
+        case trillek::EVQ_OVERFLOW_DROP: return "drop";
+        case trillek::EVQ_OVERFLOW_BLOCK: return "block";
+        case trillek::EVQ_OVERFLOW_GROW: return "grow";
+        default: return "?";
+        }
+    }
+
+    void
+    check(bool pOk, const std::string& pWhat) {
+        if (!pOk) {
+            throw std::runtime_error(pWhat);
+        }
+    }
+
+    void
+    run(trillek::system_event_overflow_t pOverflow, unsigned pProducers,
+            unsigned pEvents) {
+        using namespace trillek;
+
+        system_event_queue& queue = get_system_event_queue();
+        queue.configure(64, pOverflow);
+        queue.post_init();
+
+        std::vector<std::thread> producers;
+        for (unsigned p = 0; p < pProducers; ++p) {
+            producers.push_back(std::thread([&queue, p, pEvents]() {
+                for (unsigned i = 0; i < pEvents; ++i) {
+                    queue.push(system_event_t(EV_KEY, p, (int)i));
+                }
+            }));
+        }
+
+        // Alternate bursts of draining with pauses, so the rings fill up.
+        std::vector<int> last(pProducers, -1);
+        uint64_t received = 0;
+        uint64_t total = (uint64_t)pProducers * pEvents;
+        system_event_queue_stats stats;
+        for (unsigned round = 0; ; ++round) {
+            while (queue.more_events()) {
+                system_event_t ev = queue.get();
+                check(ev.mType == EV_KEY && ev.mSubtype < pProducers,
+                    "bad event");
+                check(ev.mData > last[ev.mSubtype], "event out of order");
+                last[ev.mSubtype] = ev.mData;
+                ++received;
+            }
+            queue.get_stats(stats);
+            if (received + stats.mDropped == total) {
+                break;
+            }
+            if (round % 4 == 0) {
+                std::this_thread::yield();
+            }
+        }
+        for (auto& t : producers) {
+            t.join();
+        }
+
+        queue.get_stats(stats);
+        uint64_t bound = pOverflow == EVQ_OVERFLOW_GROW
+            ? 2 * (uint64_t)stats.mCapacity : stats.mCapacity;
+        std::cout << policy_name(pOverflow)
+            << ": capacity " << stats.mCapacity
+            << ", high water " << stats.mHighWater
+            << ", pushed " << stats.mPushed
+            << ", dropped " << stats.mDropped << '\n';
+        check(stats.mPushed == received, "pushed events went missing");
+        check(stats.mHighWater <= bound, "high water exceeds capacity");
+        check(pOverflow != EVQ_OVERFLOW_BLOCK || stats.mDropped == 0,
+            "blocking queue dropped events");
+
+        queue.pre_shutdown();
+    }
+
+}
+
+
+int
+main(int argc, char* argv[]) {
+    using namespace trillek;
+
+    unsigned producers = argc > 1 ? std::atoi(argv[1]) : 8;
+    unsigned events = argc > 2 ? std::atoi(argv[2]) : 200000;
+    if (producers == 0 || events == 0) {
+        std::cerr << "usage: " << argv[0]
+            << " [producers] [events-per-producer]\n";
+        return 1;
+    }
+
+    try {
+        run(EVQ_OVERFLOW_DROP, producers, events);
+        run(EVQ_OVERFLOW_BLOCK, producers, events);
+        run(EVQ_OVERFLOW_GROW, producers, events);
+    }
+    catch (std::exception& e) {
+        std::cerr << argv[0] << ": " << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
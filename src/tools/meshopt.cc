@@ -0,0 +1,140 @@
+// Offline vertex cache optimisation for Wavefront OBJ meshes.
+//
+//   trillek-meshopt in.obj [out.obj]
+//
+// Faces are triangulated, triangles reordered for the post-transform
+// vertex cache and vertices for fetch locality, exactly as
+// indexed_mesh_builder does at load time, and the ACMR is reported before
+// and after. Only positions and faces are kept.
+
+#include <mesh_optimize.hh>
+#include <triangulate.hh>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+    struct obj_mesh {
+        std::vector<trillek::point3_t> mPositions;
+        std::vector<uint32_t> mIndices;
+    };
+
+    // Position index from an OBJ face corner such as "7", "7/2" or "-1//3".
+    uint32_t
+    parse_corner(const std::string& pCorner, uint32_t pPositions) {
+        long i = std::strtol(pCorner.c_str(), nullptr, 10);
+        if (i < 0) {
+            i += pPositions + 1;
+        }
+        if (i < 1 || (uint32_t)i > pPositions) {
+            throw std::runtime_error("bad face index: " + pCorner);
+        }
+        return i - 1;
+    }
+
+    void
+    read_obj(std::istream& pIn, obj_mesh& pMesh) {
+        using namespace trillek;
+
+        std::string line;
+        std::vector<uint32_t> face;
+        std::vector<point3_t> outline;
+        std::vector<uint32_t> triangles;
+        while (std::getline(pIn, line)) {
+            std::istringstream words(line);
+            std::string tag;
+            words >> tag;
+            if (tag == "v") {
+                float_t x = 0, y = 0, z = 0;
+                words >> x >> y >> z;
+                pMesh.mPositions.push_back(point3_t(x, y, z));
+            }
+            else if (tag == "f") {
+                face.clear();
+                std::string corner;
+                while (words >> corner) {
+                    face.push_back(
+                        parse_corner(corner, pMesh.mPositions.size())
+                    );
+                }
+
+                outline.clear();
+                for (auto v : face) {
+                    outline.push_back(pMesh.mPositions[v]);
+                }
+                triangles.clear();
+                triangulate_polygon(outline.data(), outline.size(), triangles);
+                for (auto t : triangles) {
+                    pMesh.mIndices.push_back(face[t]);
+                }
+            }
+        }
+    }
+
+    void
+    write_obj(std::ostream& pOut, const std::vector<uint8_t>& pVertices,
+            const std::vector<uint32_t>& pIndices) {
+        const trillek::point3_t* p
+            = reinterpret_cast<const trillek::point3_t*>(pVertices.data());
+        uint32_t count = pVertices.size() / sizeof(trillek::point3_t);
+        for (uint32_t i = 0; i < count; ++i) {
+            pOut << "v " << p[i].x << ' ' << p[i].y << ' ' << p[i].z << '\n';
+        }
+        for (std::size_t i = 0; i < pIndices.size(); i += 3) {
+            pOut << "f " << pIndices[i] + 1 << ' ' << pIndices[i + 1] + 1
+                << ' ' << pIndices[i + 2] + 1 << '\n';
+        }
+    }
+
+}
+
+
+int
+main(int argc, char* argv[]) {
+    using namespace trillek;
+
+    if (argc < 2 || argc > 3) {
+        std::cerr << "usage: " << argv[0] << " in.obj [out.obj]\n";
+        return 1;
+    }
+
+    try {
+        std::ifstream in(argv[1]);
+        if (!in) {
+            throw std::runtime_error(std::string("cannot open ") + argv[1]);
+        }
+        obj_mesh m;
+        read_obj(in, m);
+
+        std::vector<uint8_t> vertices(
+            m.mPositions.size() * sizeof(point3_t)
+        );
+        std::memcpy(vertices.data(), m.mPositions.data(), vertices.size());
+
+        vertex_cache_stats stats = optimize_triangle_list(vertices,
+                sizeof(point3_t), m.mIndices);
+
+        std::cout << argv[1] << ": " << m.mIndices.size() / 3
+            << " triangles, " << stats.mVerticesBefore << " -> "
+            << stats.mVerticesAfter << " vertices, ACMR "
+            << stats.mAcmrBefore << " -> " << stats.mAcmrAfter << '\n';
+
+        if (argc == 3) {
+            std::ofstream out(argv[2]);
+            write_obj(out, vertices, m.mIndices);
+            if (!out) {
+                throw std::runtime_error(
+                    std::string("cannot write ") + argv[2]
+                );
+            }
+        }
+    }
+    catch (std::exception& e) {
+        std::cerr << argv[0] << ": " << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}